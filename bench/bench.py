@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+# bench.py PARSER [--update] [--threshold PCT]
+#
+# Compiles every kernel in kernels.txt to intercodes, runs them with
+# irsim and compares the static size (intercodes other than LABEL and
+# FUNCTION) & the dynamic instruction count against baseline.txt.
+# Exits 1 when an output changed or a count grew beyond the threshold.
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+IRSIM = os.path.join(HERE, '..', 'irsim', 'irsim_cli.py')
+KERNELS = os.path.join(HERE, 'kernels.txt')
+BASELINE = os.path.join(HERE, 'baseline.txt')
+
+
+def readTable(path):
+    # name followed by whitespace separated fields, # starts a comment
+    table = {}
+    if not os.path.exists(path):
+        return table
+    with open(path) as f:
+        for line in f:
+            fields = line.split('#')[0].split()
+            if fields:
+                table[fields[0]] = fields[1:]
+    return table
+
+
+def measure(parser, name, inputs, tmp):
+    src = os.path.join(HERE, name + '.cmm')
+    ir = os.path.join(tmp, name + '.ir')
+    res = subprocess.run([parser, src, ir, '--ir'],
+                         stderr=subprocess.PIPE, text=True)
+    if res.returncode != 0:
+        return name, None, 'compile failed: ' + res.stderr.strip()
+    with open(ir) as f:
+        static = sum(1 for line in f if line.strip() and
+                     not line.startswith(('LABEL', 'FUNCTION')))
+    res = subprocess.run([sys.executable, IRSIM, '-c', ir] + inputs,
+                         stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                         text=True)
+    total = re.search(r'Total instructions = (\d+)', res.stdout)
+    output = re.search(r'Output:(.*)', res.stdout)
+    if 'gracefully' not in res.stdout or not total or not output:
+        return name, None, 'irsim failed: ' + res.stdout.strip()
+    return name, (static, int(total.group(1)), output.group(1).split()), ''
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('parser')
+    ap.add_argument('--update', action='store_true',
+                    help='write the counts measured as the new baseline')
+    ap.add_argument('--threshold', type=float, default=2.0,
+                    help='percent a count may grow before failing')
+    args = ap.parse_args()
+
+    kernels = readTable(KERNELS)
+    with tempfile.TemporaryDirectory() as tmp, ThreadPoolExecutor() as pool:
+        results = list(pool.map(
+            lambda k: measure(os.path.abspath(args.parser), k, kernels[k],
+                              tmp), kernels))
+
+    failed = False
+    for name, result, error in results:
+        if result is None:
+            print('%-10s %s' % (name, error))
+            failed = True
+    if failed:
+        return 1
+
+    if args.update:
+        with open(BASELINE, 'w') as f:
+            f.write('# kernel  static  dynamic  output...\n')
+            for name, (static, dynamic, output), _ in results:
+                f.write(' '.join([name, str(static), str(dynamic)] + output)
+                        + '\n')
+        print('baseline written to', os.path.relpath(BASELINE))
+        return 0
+
+    baseline = readTable(BASELINE)
+    limit = 1 + args.threshold / 100
+    print('%-10s %8s %8s %10s %10s' %
+          ('kernel', 'static', 'base', 'dynamic', 'base'))
+    for name, (static, dynamic, output), _ in results:
+        base = baseline.get(name)
+        if base is None:
+            print('%-10s %8d %8s %10d %10s  no baseline' %
+                  (name, static, '-', dynamic, '-'))
+            continue
+        bstatic, bdynamic, boutput = int(base[0]), int(base[1]), base[2:]
+        notes = []
+        if output != boutput:
+            notes.append('OUTPUT %s, expected %s' %
+                         (' '.join(output), ' '.join(boutput)))
+        if static > bstatic * limit:
+            notes.append('STATIC REGRESSION')
+        if dynamic > bdynamic * limit:
+            notes.append('DYNAMIC REGRESSION')
+        failed = failed or bool(notes)
+        print('%-10s %8d %8d %10d %10d  %+.1f%% %s' %
+              (name, static, bstatic, dynamic, bdynamic,
+               (dynamic - bdynamic) * 100.0 / bdynamic, ' '.join(notes)))
+    if failed:
+        print('changed outputs or growth beyond %g%%, run make bench-baseline '
+              'if they are intended' % args.threshold)
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
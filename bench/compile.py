@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+# compile.py PARSER [--steps N] [--scale F] [parser options...]
+#
+# Times the compiler on programs from gen.py, each shape at a base size
+# doubled --steps - 1 times. For every size the wall time of each phase
+# & the peak RSS come from --time-report; the growth column is log2 of
+# how much the total grew over the last doubling, ~1 linear, ~2 quadratic.
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+GEN = os.path.join(HERE, 'gen.py')
+PHASES = ['parse', 'translate', 'semantic', 'optimize', 'emit']
+# shape & base size, about as long to compile as each other
+SHAPES = [('funcs', 500), ('depth', 200), ('chain', 250), ('cond', 1000),
+          ('array', 20000)]
+
+
+def compile(parser, shape, size, options, tmp):
+    src = os.path.join(tmp, '%s%d.cmm' % (shape, size))
+    subprocess.run([sys.executable, GEN, '--' + shape, str(size), '-o', src],
+                   check=True)
+    res = subprocess.run([parser, src, os.path.join(tmp, 'out.s'),
+                          '--time-report'] + options,
+                         stderr=subprocess.PIPE, text=True)
+    if res.returncode != 0:
+        sys.exit('%s %d: compile failed\n%s' % (shape, size, res.stderr))
+    report = json.loads(res.stderr.splitlines()[-1])
+    times = {k: v['wall'] for k, v in report['phases'].items()}
+    times['total'] = report['total']['wall']
+    return times, report['peak_rss_kb']
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('parser')
+    ap.add_argument('--steps', type=int, default=3)
+    ap.add_argument('--scale', type=float, default=1.0,
+                    help='multiply the base sizes')
+    args, options = ap.parse_known_args()
+
+    print('%-6s %7s %s %9s %9s %6s' %
+          ('shape', 'size', ' '.join('%9s' % p for p in PHASES), 'total',
+           'rss(KB)', 'growth'))
+    with tempfile.TemporaryDirectory() as tmp:
+        for shape, base in SHAPES:
+            last = None
+            for step in range(args.steps):
+                size = int(base * args.scale) << step
+                times, rss = compile(os.path.abspath(args.parser), shape,
+                                     size, options, tmp)
+                total = times['total']
+                growth = ''
+                if last and last > 0 and total > 0:
+                    growth = '%.2f' % math.log2(total / last)
+                print('%-6s %7d %s %9.4f %9d %6s' %
+                      (shape, size,
+                       ' '.join('%9.4f' % times.get(p, 0) for p in PHASES),
+                       total, rss, growth))
+                last = total
+
+
+if __name__ == '__main__':
+    main()
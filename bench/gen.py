@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# gen.py [--funcs N] [--depth N] [--chain N] [--cond N] [--array N] [-o FILE]
+#
+# Writes a C-- program of the shape asked for, to see how the compiler
+# scales with it. Each shape goes into its own function:
+#   --funcs  N functions calling each other in a chain
+#   --depth  if & while nested N deep
+#   --chain  an expression of N terms
+#   --cond   a condition of N comparisons joined by && and ||
+#   --array  arrays of N elements, copied and indexed all over
+# The program reads nothing, ends and writes one number per shape. Values
+# stay far from 32 bits & non-negative where they are divided, so every
+# backend computes the same numbers without overflow traps.
+import argparse
+import sys
+
+
+def funcs(n, out):
+    out.append('int f0(int a, int b) { return a - b; }')
+    for k in range(1, n + 1):
+        # a & b below 1000, c below 8000 before it is reduced
+        out.append('int f%d(int a, int b) {' % k)
+        out.append('  int c = a + b * %d;' % (k % 7 + 1))
+        out.append('  c = c - c / 1000 * 1000;')
+        out.append('  return f%d(c, a / 2 + %d);' % (k - 1, k % 5))
+        out.append('}')
+    return 'f%d(1, 2)' % n
+
+
+def nest(n, out):
+    out.append('int nest(int x) {')
+    out.append('  int s = 0;')
+    indent = '  '
+    for k in range(n):
+        if k % 2 == 0:
+            out.append(indent + 'if (x > %d - 3) {' % k)
+        else:
+            out.append(indent + 'while (x < %d) {' % k)
+            out.append(indent + '  x = x + 1;')
+        out.append(indent + '  s = s + x;')
+        indent += '  '
+    for k in range(n):
+        indent = indent[:-2]
+        out.append(indent + '}')
+    out.append('  return s;')
+    out.append('}')
+    return 'nest(0)'
+
+
+def chain(n, out):
+    # each * joins two terms of at most 9, the sum grows by at most 81
+    # a term, so n terms stay below 81 n
+    out.append('int chain(int a, int b, int c) {')
+    ops = ['+', '-', '*', '+', '-']
+    terms = []
+    for k in range(n):
+        term = ['a', 'b', 'c', str(k % 9 + 1)][k % 4]
+        if k % 11 == 10:
+            term = '(%s - %d)' % (term, k % 13)
+        terms.append(term)
+        if k + 1 < n:
+            terms.append(ops[k % len(ops)])
+    out.append('  return %s;' % ' '.join(terms or ['0']))
+    out.append('}')
+    return 'chain(3, 5, 7)'
+
+
+def cond(n, out):
+    out.append('int cond(int a, int b) {')
+    rel = ['<', '>', '==', '!=', '<=', '>=']
+    terms = []
+    for k in range(n):
+        terms.append('%s %s %d' % ('ab'[k % 2], rel[k % len(rel)], k % 17))
+        if k + 1 < n:
+            terms.append('&&' if k % 3 == 2 else '||')
+    out.append('  if (%s) return 1;' % ' '.join(terms or ['a']))
+    out.append('  return 0;')
+    out.append('}')
+    return 'cond(4, 9)'
+
+
+def array(n, out):
+    out.append('int wide() {')
+    out.append('  int a[%d], b[%d];' % (n, n))
+    out.append('  int i = 0, s = 0;')
+    out.append('  while (i < %d) { a[i] = i * 3; i = i + 1; }' % n)
+    step = max(1, n // 64)
+    for k in range(0, n, step):
+        out.append('  a[%d] = a[%d] + %d;' % (k, n - 1 - k, k))
+    out.append('  b = a;')
+    for k in range(0, n, step):
+        out.append('  s = s + b[%d];' % k)
+    out.append('  return s;')
+    out.append('}')
+    return 'wide()'
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    for shape in ('funcs', 'depth', 'chain', 'cond', 'array'):
+        ap.add_argument('--' + shape, type=int, default=0)
+    ap.add_argument('-o', '--output')
+    args = ap.parse_args()
+
+    out, calls = [], []
+    if args.funcs > 0:
+        calls.append(funcs(args.funcs, out))
+    if args.depth > 0:
+        calls.append(nest(args.depth, out))
+    if args.chain > 0:
+        calls.append(chain(args.chain, out))
+    if args.cond > 0:
+        calls.append(cond(args.cond, out))
+    if args.array > 0:
+        calls.append(array(args.array, out))
+    out.append('int main() {')
+    for call in calls:
+        out.append('  write(%s);' % call)
+    out.append('  return 0;')
+    out.append('}')
+
+    f = open(args.output, 'w') if args.output else sys.stdout
+    f.write('\n'.join(out) + '\n')
+    if args.output:
+        f.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -8,6 +8,8 @@ from typing import Dict, List, Tuple
 __version__ = '1.0.2'
 
 MAX_TIME_OUT = 10
+# ARG #n; t := CALL __prof counts block n of a -fprofile-generate program
+PROFILE_FUNC = '__prof'
 
 
 def error(*arg):
@@ -41,7 +43,8 @@ class UnknownOpCodeError(Exception):
 
 class IRSimCli():
 
-    def __init__(self, inputFile: str, stdin: List[int], divC: bool = False) -> None:
+    def __init__(self, inputFile: str, stdin: List[int], divC: bool = False,
+                 profile: str = None) -> None:
         self.ip: int = -1
         self.entranceIP: int = -1
         self.offset: int = 0
@@ -55,6 +58,8 @@ class IRSimCli():
         self.labelTable = dict()
         self.callStack = list()
         self.argumentStack = list()
+        self.counters: Dict[int, int] = dict()
+        self.profile = profile
         self.input = stdin
         self.loadFile(inputFile)
         self.console = []
@@ -108,6 +113,8 @@ class IRSimCli():
             print(
                 f'Program has exited gracefully.\nTotal instructions = {self.instrCnt}')
             print(f'Output: {" ".join(self.console)}')
+            if self.profile:
+                self.writeProfile()
             exit(0)
         elif error_code == 2:
             error('An error occurred at line %d: Illegal memory access. \nIf this message keeps popping out, please reload the source file' % (self.ip + 1))
@@ -119,12 +126,20 @@ class IRSimCli():
                 f'Program runs for more than {MAX_TIME_OUT} seconds. Check dead loop or make "MAX_TIME_OUT" larger.')
         self.ip = -1
 
+    def writeProfile(self):
+        # every counter of the program, those that never ran too
+        with open(self.profile, 'w') as fp:
+            fp.write('# block count\n')
+            for n in sorted(self.counters):
+                fp.write(f'{n} {self.counters[n]}\n')
+
     def stop(self):
         self.ip = -1
         self.instrCnt = 0
         self.mem = [0] * 262144
         self.callStack = list()
         self.argumentStack = list()
+        self.counters = {n: 0 for n in self.counters}
         self.start_time = time.time()
         self.write_time = 0
 
@@ -218,7 +233,12 @@ class IRSimCli():
                     if strs[5] not in self.labelTable:
                         raise UndefinedLabelError
                 elif len(strs) > 2 and strs[2] == 'CALL':
-                    if strs[3] not in self.labelTable:
+                    if strs[3] == PROFILE_FUNC:
+                        prev = self.rawcodes[i - 1].split()
+                        if prev[0] != 'ARG' or prev[1][0] != '#':
+                            raise UndefinedLabelError
+                        self.counters[int(prev[1][1:])] = 0
+                    elif strs[3] not in self.labelTable:
                         raise UndefinedLabelError
         except UndefinedLabelError:
             error('Undefined label at line %d:\n\n%s' % (i + 1, code))
@@ -311,6 +331,9 @@ class IRSimCli():
 
                 self.offset = stackItem[3]
                 self.mem[self.symTable[stackItem[1]][0] // 4] = returnValue
+            elif code[0] == 'CALL' and code[2] == PROFILE_FUNC:
+                self.counters[self.argumentStack.pop()] += 1
+                self.mem[self.symTable[code[1]][0] // 4] = 0
             elif code[0] == 'CALL':
                 oldAddrs = dict()
                 oldOffset = self.offset
@@ -349,6 +372,9 @@ if __name__ == '__main__':
                         help='input for the program')
     parser.add_argument('-c', '--cdiv', action="store_true",
                         help='divide like c or not')
+    parser.add_argument('-p', '--profile', type=str,
+                        help='write the block counts of a -fprofile-generate '
+                        'program to this file')
     args = parser.parse_args(sys.argv[1:])
 
-    IRSimCli(args.input, args.number, args.cdiv).run()
+    IRSimCli(args.input, args.number, args.cdiv, args.profile).run()
@@ -0,0 +1,71 @@
+#include "analysis.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "defuse.h"
+
+// each worker optimizes one function at a time
+static THREAD_LOCAL interCode* current = NULL;
+static THREAD_LOCAL block* blocks = NULL;
+// CodeVersion each analysis was computed at, -1 if never
+static THREAD_LOCAL int cfgAt = -1;
+static THREAD_LOCAL int livenessAt = -1;
+
+void beginAnalyses(interCode* head) {
+    endAnalyses();
+    current = head;
+    // anything stamped for the previous function is out of date
+    CodeVersion++;
+}
+
+void endAnalyses() {
+    freeBlocks(blocks);
+    blocks = NULL;
+    current = NULL;
+    endDefUse();
+    cfgAt = -1;
+    livenessAt = -1;
+}
+
+block* requireCFG() {
+    assert(current);
+    if (cfgAt == CodeVersion) return blocks;
+    freeBlocks(blocks);
+    initBlock();
+    blocks = getFlowGraph(getBlocks(current));
+    cfgAt = CodeVersion;
+    livenessAt = -1;  // it lived in the old blocks
+    return blocks;
+}
+
+void requireDefUse() {
+    // built once, the chains then follow every change
+    assert(current);
+    if (isDefUseTracked()) return;
+    initDefUse();
+    getDefsAndUses(current);
+}
+
+block* requireLiveness() {
+    block* entry = requireCFG();
+    if (livenessAt == CodeVersion) return entry;
+    for (block* b = entry; b; b = b->next) setBlockUseDef(b);
+    while (setBlockUseIn(entry))
+        ;
+    livenessAt = CodeVersion;
+    return entry;
+}
+
+int validAnalyses() {
+    int kinds = 0;
+    if (cfgAt == CodeVersion) kinds |= CFG_A;
+    if (isDefUseTracked()) kinds |= DEFUSE_A;
+    if (livenessAt == CodeVersion) kinds |= LIVENESS_A;
+    return kinds;
+}
+
+void keepAnalyses(int kinds) {
+    if (kinds & CFG_A) cfgAt = CodeVersion;
+    if (kinds & LIVENESS_A) livenessAt = CodeVersion;
+}
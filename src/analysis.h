@@ -0,0 +1,28 @@
+#ifndef __ANALYSIS_H__
+#define __ANALYSIS_H__
+
+#include "block.h"
+#include "intercode.h"
+
+// analyses of the function being optimized, computed on demand and
+// kept until the code changes under a pass that does not preserve them
+enum analysis_kind {
+    CFG_A = 1,       // blocks & flow graph
+    DEFUSE_A = 2,    // defTable & useTable, never out of date once built
+    LIVENESS_A = 4,  // useDef & useIn of each block, needs CFG_A
+    ALL_A = 7
+};
+
+void beginAnalyses(interCode* head);
+void endAnalyses();
+
+block* requireCFG();
+void requireDefUse();
+block* requireLiveness();
+
+// analyses that are up to date with the code right now
+int validAnalyses();
+// a pass changed the code but kept these up to date itself
+void keepAnalyses(int kinds);
+
+#endif
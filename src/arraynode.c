@@ -27,6 +27,17 @@ arrayNode* insertArrayNode(arrayNode* head, arrayNode* node) {
     return node;
 }
 
+void freeArrayNodes(arrayNode* head) {
+    // nodes form a ring
+    arrayNode* node = head->next;
+    while (node != head) {
+        arrayNode* next = node->next;
+        free(node);
+        node = next;
+    }
+    free(head);
+}
+
 void setArrayNodeVarId(arrayNode* head, int id) {
     // Caution: MUST use this after DEC an array
     arrayNode* node = head;
@@ -18,6 +18,7 @@ typedef struct _arrayNode {
 
 arrayNode* newArrayNode(int size);
 arrayNode* insertArrayNode(arrayNode* head, arrayNode* node);
+void freeArrayNodes(arrayNode* head);
 arrayNode* getArrayNodeTail(arrayNode* node);
 arrayNode* getArrayNodeHead(arrayNode* node);
 bool isArrayNodeTail(arrayNode* node);
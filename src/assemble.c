@@ -1,5 +1,7 @@
 #include "assemble.h"
 
+#include "optimize.h"
+
 const char asm_header[] =
     ".data\n\
 _prompt: .asciiz \"Enter an integer:\"\n\
@@ -26,6 +28,7 @@ write:\n\
 
 #define fpwrite(fmt, ...)                  \
     do {                                   \
+        markLine();                        \
         fputs("  ", file);                 \
         fprintf(file, fmt, ##__VA_ARGS__); \
         fputc('\n', file);                 \
@@ -78,8 +81,29 @@ write:\n\
         fpcomment("%5s -> $%s", oprbuffer, reg); \
     } while (0)
 
-static position* ptable = NULL;
-static FILE* file = NULL;
+// position table & stream of the function being emitted
+static THREAD_LOCAL position* ptable = NULL;
+static THREAD_LOCAL int ptable_size = 0;
+static THREAD_LOCAL FILE* file = NULL;
+// incoming argument slots & local arrays of the function, see allocStack
+static THREAD_LOCAL int frameParams = 0;
+static THREAD_LOCAL bool frameArrays = false;
+// source line of the code being generated & the last one marked
+static THREAD_LOCAL int codeLine = 0;
+static THREAD_LOCAL int markedLine = 0;
+
+static void markLine() {
+    // "# line N" ahead of the first instruction of each source line,
+    // so that profiles of the assembly can be attributed to the source
+    if (codeLine == 0 || codeLine == markedLine) return;
+    markedLine = codeLine;
+    fprintf(file, "  # line %d\n", codeLine);
+}
+
+typedef struct _asmJob {
+    interCode** codes;
+    FILE** outs;
+} asmJob;
 
 int getOffset(operand opr) {
     assert(OPR_TYPE(opr) == VARIABLE || OPR_TYPE(opr) == TEMP);
@@ -255,9 +279,40 @@ void genSingleCode(interCode* code) {
     ic_comment(code);
 }
 
+bool isTailCall(interCode* code) {
+    // x := CALL g; RETURN x, g's arguments fit in our incoming ones and
+    // nothing g gets may point into our frame
+    if (OptLevel < 1 || code->ic_type != CALL || frameArrays ||
+        code->next->ic_type != RETURN_IC ||
+        !sameOpr(code->next->opr, code->call.dst))
+        return false;
+    int argc = 0;
+    for (interCode* arg = code->prev; arg->ic_type == ARG; arg = arg->prev)
+        argc++;
+    return argc <= frameParams;
+}
+
+void genTailCall(interCode* code) {
+    // the arguments are pushed already, the one next to the CALL on top:
+    // move them over our own, drop the frame & jump, g returns to our caller
+    int argc = 0;
+    for (interCode* arg = code->prev; arg->ic_type == ARG; arg = arg->prev) {
+        fpwrite("lw $t0, %d($sp)", 4 * argc);
+        fpwrite("sw $t0, %d($fp)", 4 * (argc + 2));
+        argc++;
+    }
+    leave();
+    if (strcmp(code->call.func_name, "main") == 0)
+        fpwrite("j %s", code->call.func_name);
+    else
+        fpwrite("j F_%s", code->call.func_name);
+    ic_comment(code);
+}
+
 int allocStack(interCode* entry) {
     int byte4Count = 0;
     int paramCount = 0;
+    frameArrays = false;
     int idx, size;
     interCode* iter = entry;
     do {
@@ -277,6 +332,7 @@ int allocStack(interCode* entry) {
             case DEC:
             case CALL:
                 if (iter->ic_type == DEC) {
+                    frameArrays = true;
                     idx = iter->dec.var_id;
                     size = iter->dec.size / 4;
                 } else if (iter->ic_type == CALL) {
@@ -320,6 +376,7 @@ int allocStack(interCode* entry) {
         }
         iter = iter->next;
     } while (iter != entry);
+    frameParams = paramCount;
     return byte4Count;
 }
 
@@ -347,6 +404,8 @@ void genFunction(interCode* entry) {
         fprintf(file, "%s:\n", entry->func_name);
     else
         fprintf(file, "F_%s:\n", entry->func_name);
+    codeLine = entry->line;
+    markedLine = 0;
     // push return address
     push(ra);
     // set frame pointer
@@ -364,26 +423,57 @@ void genFunction(interCode* entry) {
 
     interCode* iter = entry->next;
     while (iter != entry) {
-        genSingleCode(iter);
+        if (iter->line != 0) codeLine = iter->line;
+        if (isTailCall(iter)) {
+            genTailCall(iter);
+            iter = iter->next;  // its RETURN
+        } else {
+            genSingleCode(iter);
+        }
         iter = iter->next;
     }
 }
 
-void assembleGenerate(FILE* f, interCode** codes) {
+void genFunctionTask(int idx, void* arg) {
+    asmJob* job = (asmJob*)arg;
+    enterFunction(job->codes[idx]);
+    int size = VarCount + TempCount + 5;
+    if (ptable_size < size) {
+        free(ptable);
+        ptable = (position*)malloc(sizeof(position) * size);
+        ptable_size = size;
+    }
+    for (int i = 0; i < size; i++) {
+        ptable[i] = NullPos;
+    }
+    file = job->outs[idx];
+    fputc('\n', file);
+    genFunction(job->codes[idx]);
+}
+
+void assembleHeader(FILE* f) { fputs(asm_header, f); }
+
+void assembleFooter(FILE* f) { fputs(asm_io, f); }
+
+void assembleFunctions(FILE** outs, interCode** codes) {
     if (codes == NULL) return;
 
-    file = f;
-    ptable = (position*)malloc(sizeof(position) * (VarCount + TempCount + 5));
+    int funcCnt = 0;
+    while (codes[funcCnt] != NULL) funcCnt++;
 
-    fputs(asm_header, f);
+    // each function has its own stream, so they are emitted in parallel
+    asmJob job;
+    job.codes = codes;
+    job.outs = outs;
+    parallelFor(funcCnt, genFunctionTask, &job);
+}
 
+void assembleGenerate(FILE* f, interCode** codes) {
+    if (codes == NULL) return;
+    assembleHeader(f);
     for (interCode** code = codes; *code != NULL; code++) {
-        for (int i = 0; i < VarCount + TempCount + 5; i++) {
-            ptable[i] = NullPos;
-        }
-        fputc('\n', f);
-        genFunction(*code);
+        interCode* single[2] = {*code, NULL};
+        assembleFunctions(&f, single);
     }
-
-    fputs(asm_io, f);
-}
\ No newline at end of file
+    assembleFooter(f);
+}
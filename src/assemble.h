@@ -48,5 +48,10 @@ enum regs_enum {
 };
 
 void assembleGenerate(FILE* f, interCode** codes);
+// pieces of assembleGenerate, functions may be emitted in several calls,
+// codes[i] is written to outs[i]
+void assembleHeader(FILE* f);
+void assembleFunctions(FILE** outs, interCode** codes);
+void assembleFooter(FILE* f);
 
 #endif
\ No newline at end of file
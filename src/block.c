@@ -5,53 +5,25 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_BLOCK_CNT 250
-bool DO_GLOBAL_REMOVE;
+#include "stats.h"
+
+THREAD_LOCAL bool DO_GLOBAL_REMOVE;
 
 // increase count when allocating a new block
-int blockCount = 0;
-static int previous_size = 0;
-
-block** label2Block = NULL;  // record label_id -> block ptr
-defNode** defTable = NULL;   // record var_id/temp_id -> codes def var/temp
-useNode** useTable = NULL;   // record var_id/temp_id -> codes use var/temp
-
-void initDefUse() {
-    if (defTable != NULL) {
-        for (int i = 0; i < previous_size; i++) {
-            defNode* node = defTable[i];
-            while (node != NULL) {
-                defNode* to_free = node;
-                node = node->next;
-                free(to_free);
-            }
-        }
-        free(defTable);
-        defTable = NULL;
-    }
-    if (useTable != NULL) {
-        for (int i = 0; i < previous_size; i++) {
-            useNode* node = useTable[i];
-            while (node != NULL) {
-                useNode* to_free = node;
-                node = node->next;
-                free(to_free);
-            }
-        }
-        free(useTable);
-        useTable = NULL;
-    }
-    defTable = (defNode**)malloc(sizeof(defNode*) * (VarCount + TempCount + 1));
-    useTable = (useNode**)malloc(sizeof(useNode*) * (VarCount + TempCount + 1));
-    previous_size = VarCount + TempCount + 1;
-    for (int i = 0; i < VarCount + TempCount + 1; i++) {
-        defTable[i] = NULL;
-        useTable[i] = NULL;
-    }
-}
+THREAD_LOCAL int blockCount = 0;
+static THREAD_LOCAL int label_capacity = 0;
+
+// record label_id -> block ptr
+THREAD_LOCAL block** label2Block = NULL;
+// labels set in label2Block, labels are numbered across the program
+// so only these are cleared for the next function
+static THREAD_LOCAL int* labelsSet = NULL;
+static THREAD_LOCAL int labelsSetCnt = 0;
+static THREAD_LOCAL int labelsSetCap = 0;
 
 codeNode* newCodeNode(interCode* code) {
     codeNode* ret = (codeNode*)malloc(sizeof(codeNode));
+    STAT_ADD(ST_BYTES, sizeof(codeNode));
     ret->code = code;
     ret->next = NULL;
     return ret;
@@ -80,120 +52,18 @@ void freeCodeNodeList(codeNode* head) {
     }
 }
 
-defNode* newDef(interCode* code) {
-    defNode* def = (defNode*)malloc(sizeof(defNode));
-    def->code = code;
-    def->next = NULL;
-    return def;
-}
-
-useNode* newUse(interCode* code) {
-    useNode* use = (useNode*)malloc(sizeof(useNode));
-    use->code = code;
-    use->next = NULL;
-    return use;
-}
-
-void insertDef(defNode* def, int idx) {
-    def->next = defTable[idx];
-    defTable[idx] = def;
-}
-
-void insertUse(useNode* use, int idx) {
-    use->next = useTable[idx];
-    useTable[idx] = use;
-}
-
-void getDefsAndUses(interCode* codes) {
-    interCode* itr = codes;
-
-    int idx = 0;
-    do {
-        if (isDefCode(itr)) {
-            defNode* def = newDef(itr);
-            if (itr->ic_type == ASSIGN)
-                idx = getOprIndex(itr->assign.dst);
-            else if (itr->ic_type == CALL)
-                idx = getOprIndex(itr->call.dst);
-            else
-                assert(0);
-            insertDef(def, idx);
-        }
-
-        operand use_opr[3];
-        int cnt = getCodeUse(itr, use_opr);
-        for (int i = 0; i < cnt; i++) {
-            idx = getOprIndex(use_opr[i]);
-            insertUse(newUse(itr), idx);
-        }
-
-        itr = itr->next;
-    } while (itr != codes);
-}
-
-void printDefs() {
-    printf("DEFTABLE::\n");
-    char buffer[100];
-    for (int i = 1; i < VarCount + 1; i++) {
-        printf("v%d :\n", i);
-        defNode* def = defTable[i];
-        while (def != NULL) {
-            interCode* code = def->code;
-            interCodeToString(buffer, code);
-            printf("  %s\n", buffer);
-            def = def->next;
-        }
-    }
-
-    for (int i = 1; i < TempCount + 1; i++) {
-        printf("t%d :\n", i);
-        defNode* def = defTable[i + VarCount];
-        while (def != NULL) {
-            interCode* code = def->code;
-            interCodeToString(buffer, code);
-            printf("  %s\n", buffer);
-            def = def->next;
-        }
-    }
-}
-
-void printUses() {
-    printf("USETABLE::\n");
-    char buffer[100];
-    for (int i = 1; i < VarCount + 1; i++) {
-        printf("v%d :\n", i);
-        useNode* use = useTable[i];
-        while (use != NULL) {
-            interCode* code = use->code;
-            interCodeToString(buffer, code);
-            printf("  %s\n", buffer);
-            use = use->next;
-        }
-    }
-
-    for (int i = 1; i < TempCount + 1; i++) {
-        printf("t%d :\n", i);
-        useNode* use = useTable[i + VarCount];
-        while (use != NULL) {
-            interCode* code = use->code;
-            interCodeToString(buffer, code);
-            printf("  %s\n", buffer);
-            use = use->next;
-        }
-    }
-}
-
 void initBlock() {
     DO_GLOBAL_REMOVE = true;
     blockCount = 0;
-    if (label2Block != NULL) {
+    // reuse the table if it is large enough
+    if (label_capacity < LabelCount + 1) {
         free(label2Block);
-        label2Block = NULL;
-    }
-    label2Block = (block**)malloc(sizeof(block*) * (LabelCount + 1));
-    for (int i = 0; i < LabelCount + 1; i++) {
-        label2Block[i] = NULL;
+        label_capacity = LabelCount + 1;
+        label2Block = (block**)calloc(label_capacity, sizeof(block*));
+    } else {
+        for (int i = 0; i < labelsSetCnt; i++) label2Block[labelsSet[i]] = NULL;
     }
+    labelsSetCnt = 0;
 }
 
 int allocBlock() {
@@ -204,6 +74,8 @@ int allocBlock() {
 block* newBlock() {
     int id = allocBlock();
     block* b = (block*)malloc(sizeof(block));
+    STAT_ADD(ST_BLOCKS, 1);
+    STAT_ADD(ST_BYTES, sizeof(block));
     b->id = id;
 
     b->first = NULL;
@@ -223,33 +95,30 @@ block* newBlock() {
     b->genMap = RB_ROOT;
     b->outMap = RB_ROOT;
 
-    b->useDef = (char*)malloc(sizeof(char) * (VarCount + TempCount + 1));
-    b->useIn = (char*)malloc(sizeof(char) * (VarCount + TempCount + 1));
-    for (int i = 0; i < VarCount + TempCount + 1; i++) {
-        b->useDef[i] = 0;
-        b->useIn[i] = 0;
-    }
+    // sized by all variables of the program, only liveness needs them
+    b->useDef = NULL;
+    b->useIn = NULL;
     b->isVisited = false;
     return b;
 }
 
+static void removeFlowPrev(block* b, block* prev) {
+    if (b->flowPrev[0] == prev) {
+        b->flowPrev[0] = b->flowPrev[1];
+        b->flowPrev[1] = NULL;
+    } else if (b->flowPrev[1] == prev) {
+        b->flowPrev[1] = NULL;
+    }
+}
+
 block* removeBlock(block* remove) {
     if (remove->next != NULL) {
         remove->next->prev = remove->prev;
     }
     remove->prev->next = remove->next;
 
-    if (remove->flowGotoNext) {
-        if (remove->flowGotoNext->flowPrev[0] == remove->flowGotoNext)
-            remove->flowGotoNext->flowPrev[0] =
-                remove->flowGotoNext->flowPrev[1];
-        remove->flowGotoNext->flowPrev[1] = NULL;
-    }
-    if (remove->flowSeqNext) {
-        if (remove->flowSeqNext->flowPrev[0] == remove->flowSeqNext)
-            remove->flowSeqNext->flowPrev[0] = remove->flowSeqNext->flowPrev[1];
-        remove->flowSeqNext->flowPrev[1] = NULL;
-    }
+    if (remove->flowGotoNext) removeFlowPrev(remove->flowGotoNext, remove);
+    if (remove->flowSeqNext) removeFlowPrev(remove->flowSeqNext, remove);
 
     block* ret = remove->next;
     interCode* codeItr = remove->first;
@@ -383,8 +252,16 @@ void setOneUseDef(block* b, interCode* itr) {
     }
 }
 
-block* setBlockUseDef(block* b) {
-    // printf("in\n");
+void setBlockUseDef(block* b) {
+    if (b->useDef == NULL) {
+        b->useDef = (char*)malloc(sizeof(char) * (VarCount + TempCount + 1));
+        b->useIn = (char*)malloc(sizeof(char) * (VarCount + TempCount + 1));
+        STAT_ADD(ST_BYTES, 2 * (VarCount + TempCount + 1));
+    }
+    for (int i = 0; i < VarCount + TempCount + 1; i++) {
+        b->useDef[i] = 0;
+        b->useIn[i] = 0;
+    }
     for (interCode* itr = b->first; itr != b->end; itr = itr->next) {
         // printf("testin\n");
         setOneUseDef(b, itr);
@@ -476,6 +353,12 @@ block* getBlocks(interCode* codes) {
             if (flag == LABEL_S) {
                 // record (label_n -> block ptr)
                 label2Block[label] = nb;
+                if (labelsSetCnt == labelsSetCap) {
+                    labelsSetCap = labelsSetCap * 2 + 16;
+                    labelsSet = (int*)realloc(labelsSet,
+                                              sizeof(int) * labelsSetCap);
+                }
+                labelsSet[labelsSetCnt++] = label;
             }
 
             // current block becomes the new tail
@@ -498,10 +381,6 @@ block* getBlocks(interCode* codes) {
 
     if (block_incr >= MAX_BLOCK_CNT) DO_GLOBAL_REMOVE = false;
 
-    for (block* itr = head; itr; itr = itr->next) {
-        setBlockUseDef(itr);
-    }
-
     return head;
 }
 
@@ -524,6 +403,12 @@ void printBlocks(block* b) {
             interCodeToString(buffer, itr->code);
             printf("    %s\n", buffer);
         }*/
+        if (b->useDef == NULL) {
+            // liveness not computed
+            b = b->next;
+            printf("\n");
+            continue;
+        }
 
         printf("|\n└Use: \n");
         for (int i = 1; i < VarCount + 1; i++) {
@@ -6,11 +6,16 @@
 
 #include "intercode.h"
 #include "map.h"
+#include "threadpool.h"
 
 struct _genNode;
 struct _outNode;
 
-extern bool DO_GLOBAL_REMOVE;
+// data flow over more blocks costs too much, see DO_GLOBAL_REMOVE
+#define MAX_BLOCK_CNT 250
+extern THREAD_LOCAL bool DO_GLOBAL_REMOVE;
+// label_id -> block it starts, filled in by getBlocks
+extern THREAD_LOCAL struct _block** label2Block;
 
 // block contains a fragment of intercodes
 typedef struct _block {
@@ -41,6 +46,7 @@ typedef struct _block {
 
 void initBlock();
 bool setOutBlocks(block* b, bool visit);
+void setBlockUseDef(block* b);
 bool setBlockUseIn(block* b);
 block* getBlocks(interCode* codes);
 void printBlocks(block* b);
@@ -60,18 +66,6 @@ typedef struct _codeNode {
     struct _codeNode* next;
 } codeNode;
 
-// def
-typedef struct _defNode {
-    interCode* code;
-    struct _defNode* next;
-} defNode;
-
-// use
-typedef struct _useNode {
-    interCode* code;
-    struct _useNode* next;
-} useNode;
-
 // gen
 typedef struct _genNode {
     interCode* code;
@@ -84,12 +78,4 @@ typedef struct _outNode {
     struct _outNode* next;
 } outNode;
 
-extern defNode** defTable;
-extern useNode** useTable;
-
-void initDefUse();
-void getDefsAndUses(interCode* codes);
-void printDefs();
-void printUses();
-
 #endif
\ No newline at end of file
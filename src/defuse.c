@@ -0,0 +1,156 @@
+#include "defuse.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// record var_id/temp_id -> codes def var/temp
+THREAD_LOCAL oprRef** defTable = NULL;
+// record var_id/temp_id -> codes use var/temp
+THREAD_LOCAL oprRef** useTable = NULL;
+static THREAD_LOCAL int tableSize = 0;
+static THREAD_LOCAL bool tracked = false;
+
+// variables/temps whose use chain has become empty
+static THREAD_LOCAL int* unused = NULL;
+static THREAD_LOCAL int unusedCnt = 0;
+static THREAD_LOCAL bool* queued = NULL;
+
+void initDefUse() {
+    int size = VarCount + TempCount + 1;
+    if (tableSize < size) {
+        free(defTable);
+        free(useTable);
+        free(unused);
+        free(queued);
+        defTable = (oprRef**)malloc(sizeof(oprRef*) * size);
+        useTable = (oprRef**)malloc(sizeof(oprRef*) * size);
+        unused = (int*)malloc(sizeof(int) * size);
+        queued = (bool*)malloc(sizeof(bool) * size);
+        tableSize = size;
+    }
+    for (int i = 0; i < size; i++) {
+        defTable[i] = NULL;
+        useTable[i] = NULL;
+        queued[i] = false;
+    }
+    unusedCnt = 0;
+    tracked = false;
+}
+
+void endDefUse() { tracked = false; }
+
+bool isDefUseTracked() { return tracked; }
+
+static void pushUnused(int idx) {
+    if (queued[idx]) return;
+    queued[idx] = true;
+    unused[unusedCnt++] = idx;
+}
+
+bool popUnused(int* idx) {
+    while (unusedCnt > 0) {
+        int top = unused[--unusedCnt];
+        queued[top] = false;
+        // it may have got a new use since
+        if (useTable[top] == NULL) {
+            *idx = top;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void chain(oprRef** table, oprRef* ref, interCode* code, int idx) {
+    ref->code = code;
+    ref->idx = idx;
+    ref->prev = NULL;
+    ref->next = table[idx];
+    if (table[idx]) table[idx]->prev = ref;
+    table[idx] = ref;
+}
+
+static void unchain(oprRef** table, oprRef* ref) {
+    if (ref->prev)
+        ref->prev->next = ref->next;
+    else
+        table[ref->idx] = ref->next;
+    if (ref->next) ref->next->prev = ref->prev;
+    ref->idx = -1;
+}
+
+void linkCode(interCode* code) {
+    if (!tracked) return;
+    assert(code->def.idx < 0);
+    if (isDefCode(code)) {
+        int idx;
+        if (code->ic_type == ASSIGN)
+            idx = getOprIndex(code->assign.dst);
+        else
+            idx = getOprIndex(code->call.dst);
+        if (idx > 0) chain(defTable, &(code->def), code, idx);
+    }
+
+    operand use_opr[3];
+    int cnt = getCodeUse(code, use_opr);
+    for (int i = 0; i < cnt; i++) {
+        int idx = getOprIndex(use_opr[i]);
+        if (idx > 0) chain(useTable, &(code->uses[i]), code, idx);
+    }
+}
+
+void unlinkCode(interCode* code) {
+    if (!tracked) return;
+    if (code->def.idx >= 0) unchain(defTable, &(code->def));
+    for (int i = 0; i < 3; i++) {
+        int idx = code->uses[i].idx;
+        if (idx < 0) continue;
+        unchain(useTable, &(code->uses[i]));
+        if (useTable[idx] == NULL) pushUnused(idx);
+    }
+}
+
+void getDefsAndUses(interCode* codes) {
+    // links left from an earlier function or round are stale
+    interCode* itr = codes;
+    do {
+        itr->def.idx = -1;
+        for (int i = 0; i < 3; i++) itr->uses[i].idx = -1;
+        itr = itr->next;
+    } while (itr != codes);
+
+    tracked = true;
+    do {
+        linkCode(itr);
+        itr = itr->next;
+    } while (itr != codes);
+
+    // popped in ascending order
+    for (int i = VarCount + TempCount; i > 0; i--) {
+        if (useTable[i] == NULL) pushUnused(i);
+    }
+}
+
+static void printChains(oprRef** table) {
+    char buffer[100];
+    for (int i = 1; i < VarCount + TempCount + 1; i++) {
+        if (i <= VarCount)
+            printf("v%d :\n", i);
+        else
+            printf("t%d :\n", i - VarCount);
+        for (oprRef* ref = table[i]; ref != NULL; ref = ref->next) {
+            interCodeToString(buffer, ref->code);
+            printf("  %s\n", buffer);
+        }
+    }
+}
+
+void printDefs() {
+    printf("DEFTABLE::\n");
+    printChains(defTable);
+}
+
+void printUses() {
+    printf("USETABLE::\n");
+    printChains(useTable);
+}
@@ -0,0 +1,27 @@
+#ifndef __DEFUSE_H__
+#define __DEFUSE_H__
+
+#include <stdbool.h>
+
+#include "intercode.h"
+
+// def-use chains of the function being optimized, indexed by
+// getOprIndex. Once built they follow every insertCodeAfter,
+// removeCode(Itr) & touchCode until endDefUse()
+extern THREAD_LOCAL oprRef** defTable;
+extern THREAD_LOCAL oprRef** useTable;
+
+void initDefUse();
+void getDefsAndUses(interCode* codes);
+void endDefUse();
+bool isDefUseTracked();
+
+void linkCode(interCode* code);
+void unlinkCode(interCode* code);
+// take a variable/temp that has lost its last use, false if none
+bool popUnused(int* idx);
+
+void printDefs();
+void printUses();
+
+#endif
@@ -16,6 +16,7 @@ extern bool yyperr;
 extern int unhandled;
 extern int preverr;
 extern treeNode* root;
+extern void (*extDefHandler)(treeNode*);
 
 extern const char* errmsgT[];
 extern const char* errmsgN[];
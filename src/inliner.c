@@ -0,0 +1,763 @@
+#include "inliner.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+#include "remarks.h"
+#include "stats.h"
+
+#define INLINE_THRESHOLD 120  // most cost of a callee once a call is saved
+#define HOT_THRESHOLD 360     // of a call the profile finds hot
+#define COLD_THRESHOLD 0      // of a call that never ran, only if it shrinks
+#define HOT_RATIO 100         // hot: runs 1/100 as often as the hottest block
+#define LABEL_COST 8          // a branch weighs more than a plain code
+#define CALL_COST 3           // CALL, RETURN & the result saved by a call
+#define ARG_COST 2            // ARG & PARAM saved by an argument
+#define CONST_ARG_BONUS 8     // a constant argument folds into the body
+#define GROWTH_FACTOR 2       // a caller may grow to twice its cost
+#define GROWTH_MIN 400        // plus this much
+#define CLONE_MAX_COST 400    // kept back to be cloned up to this cost
+#define MAX_CLONES 4          // specialized copies of one function
+#define CLONE_RATIO 4         // a clone saves at least 1/4 of its cost
+
+typedef struct _candidate {
+    interCode* code;
+    int cost;
+    int params;
+    int scc;       // component of the call graph it was processed in
+    bool kept;  // emitted at the end
+    // parameters no longer passed, see pruneParams
+    int argc;
+    bool* dropped;
+    // copies for calls that pass constants, see getClone
+    int cloneCnt;
+    struct _candidate* clones[MAX_CLONES];
+    operand* consts;  // of a clone: the constant of each parameter or EOPR
+} candidate;
+
+// arguments of the calls to a function that are still there,
+// the constant all of them pass or EOPR
+typedef struct _calledFunc {
+    int argc;
+    operand* args;
+    bool resultUsed;  // by any of the calls
+} calledFunc;
+
+// functions a function emitted already calls, to find what main reaches
+typedef struct _calleeList {
+    int cnt;
+    char (*names)[32];
+} calleeList;
+
+static root_t CalledTable = RB_ROOT;  // <funcname, calledFunc> still called
+static root_t CallGraph = RB_ROOT;    // <funcname, calleeList> emitted
+static int sccCount = 0;              // components numbered across windows
+
+static int inlineCost(interCode* head, int* params) {
+    int cost = 0;
+    *params = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        if (iter->ic_type == PARAM)
+            (*params)++;
+        else if (iter->ic_type == LABEL)
+            cost += LABEL_COST;
+        else
+            cost++;
+    }
+    return cost;
+}
+
+static int callBenefit(interCode* call, int params) {
+    int benefit = CALL_COST + ARG_COST * params;
+    interCode* arg = call->prev;
+    for (int i = 0; i < params && arg->ic_type == ARG; i++) {
+        if (IS_CONST(arg->opr)) benefit += CONST_ARG_BONUS;
+        arg = arg->prev;
+    }
+    return benefit;
+}
+
+typedef struct _labelPair {
+    int from, to;
+} labelPair;
+
+static int compareLabel(const void* a, const void* b) {
+    return ((const labelPair*)a)->from - ((const labelPair*)b)->from;
+}
+
+static int remapLabel(labelPair* labels, int count, int label) {
+    labelPair key = {label, 0};
+    labelPair* found = (labelPair*)bsearch(&key, labels, count,
+                                           sizeof(labelPair), compareLabel);
+    assert(found);
+    return found->to;
+}
+
+static void renameLabels(interCode* head) {
+    // fresh labels in the order they appear, looked up by the old ones
+    int labelCnt = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next)
+        if (iter->ic_type == LABEL) labelCnt++;
+    labelPair* labels = (labelPair*)malloc(sizeof(labelPair) * (labelCnt + 1));
+    labelCnt = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next)
+        if (iter->ic_type == LABEL)
+            labels[labelCnt++] = (labelPair){iter->label_id, allocLabel()};
+    qsort(labels, labelCnt, sizeof(labelPair), compareLabel);
+
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        if (iter->ic_type == LABEL || iter->ic_type == GOTO)
+            iter->label_id = remapLabel(labels, labelCnt, iter->label_id);
+        else if (iter->ic_type == COND)
+            iter->cond.label_id =
+                remapLabel(labels, labelCnt, iter->cond.label_id);
+    }
+    free(labels);
+}
+
+static interCode* inlineCall(interCode* call, interCode* callee) {
+    // ARG a; x := CALL f  ==>  v := a; body of f with each
+    // RETURN r as x := r; GOTO ret, LABEL ret : at its end
+    operand dst = call->call.dst;
+    interCode* next = call->next;
+    interCode* body = copyInterCode(callee);
+    // callee's variables & temps go behind the caller's ones
+    int var_shift = VarCount, tmp_shift = TempCount;
+    VarCount += body->var_cnt;
+    TempCount += body->tmp_cnt;
+
+    int ret_label = allocLabel();
+    renameLabels(body);
+
+    interCode* arg = call->prev;
+    operand* slots[3];
+    for (interCode* iter = body->next; iter != body; iter = iter->next) {
+        // the callee's counts are of all its calls, take this one's share
+        if (iter->freq > 0 && call->freq >= 0 && body->freq > 0)
+            iter->freq = (long long)((double)iter->freq * call->freq /
+                                     body->freq);
+        if (iter->ic_type == DEC) iter->dec.var_id += var_shift;
+        int cnt = getCodeOprSlots(iter, slots);
+        for (int i = 0; i < cnt; i++) {
+            if (IS_VAR(*slots[i]))
+                slots[i]->var_id += var_shift;
+            else if (IS_TEMP(*slots[i]))
+                slots[i]->tmp_id += tmp_shift;
+        }
+        switch (iter->ic_type) {
+            case PARAM: {
+                operand param = iter->opr;
+                iter->ic_type = ASSIGN;
+                iter->assign.op_type = AS;
+                iter->assign.dst = param;
+                iter->assign.src1 = arg->opr;
+                iter->assign.src2 = nullOpr;
+                arg = removeCodeItr(arg, false);
+                break;
+            }
+            case RETURN_IC: {
+                operand ret = iter->opr;
+                iter->ic_type = ASSIGN;
+                iter->assign.op_type = AS;
+                iter->assign.dst = dst;
+                iter->assign.src1 = ret;
+                iter->assign.src2 = nullOpr;
+                insertCodeAfter(iter, newGotoCode(ret_label));
+                iter = iter->next;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    interCode* end = newLabelCode(ret_label);
+    end->freq = call->freq;
+    insertCodeAfter(body->prev, end);
+    // remove FUNCTION & CALL, the body goes where the CALL was
+    body = removeCodeItr(body, true);
+    interCode* where = removeCodeItr(call, false);
+    insertCodeAfter(where, body);
+    return next;
+}
+
+static candidate* allocCandidate(interCode* head, int scc) {
+    candidate* c = (candidate*)malloc(sizeof(candidate));
+    c->code = head;
+    c->cost = inlineCost(head, &c->params);
+    c->scc = scc;
+    c->kept = false;
+    c->argc = c->params;
+    c->dropped = NULL;
+    c->cloneCnt = 0;
+    c->consts = NULL;
+    return c;
+}
+
+static candidate* newCandidate(interCode* head, int scc) {
+    // a candidate if a call with all arguments constant inlines it,
+    // or small enough to be cloned for constant arguments
+    int params;
+    int cost = inlineCost(head, &params);
+    int threshold = ProfileMax > 0 ? HOT_THRESHOLD : INLINE_THRESHOLD;
+    if (cost - CALL_COST - (ARG_COST + CONST_ARG_BONUS) * params >
+            threshold &&
+        (params == 0 || cost > CLONE_MAX_COST))
+        return NULL;
+    return allocCandidate(head, scc);
+}
+
+static int countUses(interCode* head, operand var) {
+    int count = 0;
+    operand* slots[3];
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        int cnt = getCodeOprSlots(iter, slots);
+        for (int i = 0; i < cnt; i++)
+            if (oprEqual(*slots[i], var)) count++;
+    }
+    return count;
+}
+
+static void dropArgs(interCode* call, candidate* c) {
+    interCode* arg = call->prev;
+    for (int k = 0; k < c->argc; k++) {
+        assert(arg->ic_type == ARG);
+        interCode* prev = arg->prev;
+        if (c->dropped[k]) removeCode(arg);
+        arg = prev;
+    }
+}
+
+static void pruneParams(candidate* c) {
+    // PARAMs the body never mentions go, every call to c is either in c
+    // or comes later & drops their ARGs
+    interCode* head = c->code;
+    bool* dropped = (bool*)calloc(c->argc + 1, sizeof(bool));
+    bool any = false;
+    interCode* param = head->next;
+    for (int k = 0; param->ic_type == PARAM; k++) {
+        interCode* next = param->next;
+        if (countUses(head, param->opr) == 1) {
+            dropped[k] = any = true;
+            removeCode(param);
+        }
+        param = next;
+    }
+    if (!any) {
+        free(dropped);
+        return;
+    }
+    c->dropped = dropped;
+    for (interCode* iter = head->next; iter != head; iter = iter->next)
+        if (iter->ic_type == CALL && strcmp(iter->call.func_name,
+                                            head->func_name) == 0)
+            dropArgs(iter, c);
+    c->cost = inlineCost(head, &c->params);
+    head->settled = false;
+}
+
+static interCode* bindParam(interCode* head, interCode* where, operand var,
+                            operand value) {
+    // var holds value on entry: a parameter never assigned nor used as
+    // a pointer takes value in its uses, otherwise var := value goes
+    // behind where, return the last code bound
+    bool fixed = true;
+    for (interCode* iter = head->next; iter != head && fixed;
+         iter = iter->next) {
+        if (iter->ic_type == READ || iter->ic_type == CALL ||
+            (iter->ic_type == ASSIGN && isDefCode(iter)))
+            fixed = !sameOpr(getCodeDst(iter), var);
+        if (iter->ic_type == ASSIGN &&
+            (iter->assign.op_type == ADDR || iter->assign.op_type == RSTAR ||
+             iter->assign.op_type == LSTAR || iter->assign.op_type == LRSTAR))
+            fixed = fixed && !sameOpr(iter->assign.dst, var) &&
+                    !sameOpr(iter->assign.src1, var);
+    }
+    if (!fixed) {
+        interCode* assign = newAssignCode(AS, var, value, nullOpr);
+        insertCodeAfter(where, assign);
+        return assign;
+    }
+    operand* slots[3];
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        if (iter->ic_type == PARAM) continue;
+        int cnt = getCodeOprSlots(iter, slots);
+        bool changed = false;
+        for (int i = 0; i < cnt; i++) {
+            if (!sameOpr(*slots[i], var)) continue;
+            *slots[i] = value;
+            changed = true;
+        }
+        if (changed) touchCode(iter);
+    }
+    return where;
+}
+
+static candidate* getClone(root_t* candidates, candidate* c, operand* consts) {
+    // a copy of c with the constant parameters assigned up front,
+    // one made earlier for the same constants is reused
+    for (int i = 0; i < c->cloneCnt; i++) {
+        bool same = true;
+        for (int k = 0; k < c->params; k++)
+            same = same && sameOpr(c->clones[i]->consts[k], consts[k]);
+        if (same) return c->clones[i];
+    }
+    if (c->cloneCnt == MAX_CLONES) return NULL;
+
+    // each use of a constant parameter may fold away
+    int gain = 0, k = 0;
+    interCode* head = c->code;
+    for (interCode* iter = head->next; iter->ic_type == PARAM;
+         iter = iter->next, k++) {
+        if (IS_CONST(consts[k]))
+            gain += ARG_COST + CONST_ARG_BONUS * countUses(head, iter->opr);
+    }
+    if (gain * CLONE_RATIO < c->cost) return NULL;
+
+    char name[sizeof(head->func_name) + 16];
+    snprintf(name, sizeof(name), "%s.%d", head->func_name, c->cloneCnt + 1);
+    if (strlen(name) >= sizeof(head->func_name) || get(candidates, name))
+        return NULL;
+
+    interCode* clone = copyInterCode(head);
+    strcpy(clone->func_name, name);
+    renameLabels(clone);
+    // PARAM v  ==>  v := #c behind the PARAMs left, or #c in place of v
+    interCode* where = clone;
+    while (where->next->ic_type == PARAM) where = where->next;
+    interCode* iter = clone->next;
+    for (k = 0; iter->ic_type == PARAM; k++) {
+        interCode* param = iter;
+        iter = iter->next;
+        if (!IS_CONST(consts[k])) continue;
+        where = bindParam(clone, where, param->opr, consts[k]);
+        removeCode(param);
+    }
+
+    candidate* s = allocCandidate(clone, c->scc);
+    s->consts = (operand*)malloc(sizeof(operand) * (c->params + 1));
+    memcpy(s->consts, consts, sizeof(operand) * c->params);
+    c->clones[c->cloneCnt++] = s;
+    put(candidates, name, s);
+    return s;
+}
+
+static void specializeCall(root_t* candidates, candidate* c, interCode* call,
+                           interCode* caller) {
+    // ARG a; ARG #4; x := CALL f  ==>  ARG a; x := CALL f.1
+    // clones are not cloned again
+    if (c->consts != NULL || c->params == 0) return;
+    operand* consts = (operand*)malloc(sizeof(operand) * c->params);
+    bool any = false;
+    interCode* arg = call->prev;
+    for (int k = 0; k < c->params; k++, arg = arg->prev) {
+        if (arg->ic_type != ARG) {
+            free(consts);
+            return;
+        }
+        consts[k] = IS_CONST(arg->opr) ? arg->opr : nullOpr;
+        any = any || IS_CONST(arg->opr);
+    }
+    candidate* s = any ? getClone(candidates, c, consts) : NULL;
+    if (any && s == NULL)
+        remark(RM_MISSED, "clone", caller, call->line,
+               "no clone of %s for its constant arguments, too little "
+               "would fold (%d of %d clones made)",
+               c->code->func_name, c->cloneCnt, MAX_CLONES);
+    if (s != NULL) {
+        remark(RM_PASSED, "clone", caller, call->line,
+               "call to %s specialized as %s for its constant arguments",
+               c->code->func_name, s->code->func_name);
+        arg = call->prev;
+        for (int k = 0; k < c->params; k++) {
+            interCode* prev = arg->prev;
+            if (IS_CONST(consts[k])) removeCode(arg);
+            arg = prev;
+        }
+        strcpy(call->call.func_name, s->code->func_name);
+        touchCode(call);
+    }
+    free(consts);
+}
+
+static int callThreshold(interCode* call) {
+    // calls the profile never saw run are not worth growing the code for
+    if (call->freq < 0) return INLINE_THRESHOLD;
+    if (call->freq == 0) return COLD_THRESHOLD;
+    if (call->freq * HOT_RATIO >= ProfileMax) return HOT_THRESHOLD;
+    return INLINE_THRESHOLD;
+}
+
+static void inlineCalls(interCode* head, root_t* candidates, int scc) {
+    int params;
+    int cost = inlineCost(head, &params);
+    int budget = cost * GROWTH_FACTOR + GROWTH_MIN;
+    interCode* iter = head->next;
+    while (iter != head) {
+        map_t* found =
+            iter->ic_type == CALL ? get(candidates, iter->call.func_name) : NULL;
+        candidate* c = found ? (candidate*)found->val : NULL;
+        if (c != NULL && c->dropped != NULL) dropArgs(iter, c);
+        if (iter->ic_type == CALL && c == NULL &&
+            strcmp(iter->call.func_name, PROFILE_FUNC) != 0)
+            remark(RM_MISSED, "inline", head, iter->line,
+                   strcmp(iter->call.func_name, head->func_name) == 0
+                       ? "%s calls itself"
+                       : "%s is too large to inline or clone, or recursive "
+                         "with the caller",
+                   iter->call.func_name);
+        // a callee in the same component calls back into the caller
+        if (c == NULL || c->scc == scc) {
+            if (c != NULL)
+                remark(RM_MISSED, "inline", head, iter->line,
+                       "%s is recursive with the caller",
+                       iter->call.func_name);
+            iter = iter->next;
+            continue;
+        }
+        int benefit = callBenefit(iter, c->params);
+        int threshold = callThreshold(iter);
+        if (c->cost - benefit <= threshold && cost + c->cost <= budget) {
+            remark(RM_PASSED, "inline", head, iter->line,
+                   "%s inlined, cost %d - benefit %d <= %d",
+                   c->code->func_name, c->cost, benefit, threshold);
+            // callees were done first, the copy is not looked into again
+            cost += c->cost;
+            iter = inlineCall(iter, c->code);
+            STAT_ADD(ST_INLINED, 1);
+            continue;
+        }
+        if (c->cost - benefit > threshold)
+            remark(RM_MISSED, "inline", head, iter->line,
+                   "%s costs %d - benefit %d > %d", c->code->func_name,
+                   c->cost, benefit, threshold);
+        else
+            remark(RM_MISSED, "inline", head, iter->line,
+                   "%s would grow the caller to %d > budget %d",
+                   c->code->func_name, cost + c->cost, budget);
+        specializeCall(candidates, c, iter, head);
+        iter = iter->next;
+    }
+}
+
+static void eliminateTailCalls(interCode* head) {
+    // ARG a; x := CALL f; RETURN x in f itself  ==>  t := a; p := t;
+    // GOTO entry, LABEL entry behind the PARAMs. Local arrays would be
+    // shared by all the calls, a function with any keeps its calls
+    int params = 0;
+    interCode* entry = head;
+    while (entry->next->ic_type == PARAM) {
+        entry = entry->next;
+        params++;
+    }
+    for (interCode* iter = head->next; iter != head; iter = iter->next)
+        if (iter->ic_type == DEC) return;
+    int entryLabel = -1;
+
+    interCode* iter = head->next;
+    while (iter != head) {
+        interCode* ret = iter->next;
+        if (iter->ic_type != CALL || ret->ic_type != RETURN_IC ||
+            !sameOpr(ret->opr, iter->call.dst) ||
+            strcmp(iter->call.func_name, head->func_name) != 0) {
+            iter = ret;
+            continue;
+        }
+        if (entryLabel < 0) {
+            entryLabel = allocLabel();
+            insertCodeAfter(entry, newLabelCode(entryLabel));
+        }
+        // all arguments are read before any parameter is written
+        interCode* arg = iter->prev;
+        interCode* param = head->next;
+        for (int k = 0; k < params; k++) {
+            assert(arg->ic_type == ARG && param->ic_type == PARAM);
+            operand tmp = allocTemp();
+            insertCodeAfter(arg, newAssignCode(AS, tmp, arg->opr, nullOpr));
+            insertCodeAfter(iter->prev, newAssignCode(AS, param->opr, tmp,
+                                                       nullOpr));
+            arg = removeCodeItr(arg, false);
+            param = param->next;
+        }
+        remark(RM_PASSED, "tail-call", head, iter->line,
+               "recursive tail call turned into a jump");
+        insertCodeAfter(iter, newGotoCode(entryLabel));
+        removeCode(ret);
+        iter = removeCodeItr(iter, true)->next;
+    }
+}
+
+// call graph of a window, components found by Tarjan's algorithm
+typedef struct _callGraph {
+    int n;
+    bool* calls;  // [caller * n + callee]
+    int* order;   // visit order, -1 if not visited
+    int* low;
+    int* scc;
+    int* stack;
+    bool* onStack;
+    int visited, top;
+} callGraph;
+
+static void strongConnect(callGraph* g, int v) {
+    g->order[v] = g->low[v] = g->visited++;
+    g->stack[g->top++] = v;
+    g->onStack[v] = true;
+    for (int w = 0; w < g->n; w++) {
+        if (!g->calls[v * g->n + w]) continue;
+        if (g->order[w] < 0) {
+            strongConnect(g, w);
+            if (g->low[w] < g->low[v]) g->low[v] = g->low[w];
+        } else if (g->onStack[w] && g->order[w] < g->low[v]) {
+            g->low[v] = g->order[w];
+        }
+    }
+    if (g->low[v] != g->order[v]) return;
+    // components are numbered after all the ones they call
+    int w;
+    do {
+        w = g->stack[--g->top];
+        g->onStack[w] = false;
+        g->scc[w] = sccCount;
+    } while (w != v);
+    sccCount++;
+}
+
+static void getComponents(interCode** funcs, int count, int* scc) {
+    root_t names = RB_ROOT;  // <funcname, index in funcs>
+    int* index = (int*)malloc(sizeof(int) * count);
+    for (int i = 0; i < count; i++) {
+        index[i] = i;
+        put(&names, funcs[i]->func_name, &index[i]);
+    }
+    callGraph g;
+    g.n = count;
+    g.calls = (bool*)calloc(count * count, sizeof(bool));
+    g.order = (int*)malloc(sizeof(int) * count);
+    g.low = (int*)malloc(sizeof(int) * count);
+    g.scc = scc;
+    g.stack = (int*)malloc(sizeof(int) * count);
+    g.onStack = (bool*)calloc(count, sizeof(bool));
+    g.visited = g.top = 0;
+    for (int i = 0; i < count; i++) {
+        g.order[i] = -1;
+        interCode* head = funcs[i];
+        for (interCode* iter = head->next; iter != head; iter = iter->next) {
+            if (iter->ic_type != CALL) continue;
+            map_t* callee = get(&names, iter->call.func_name);
+            if (callee) g.calls[i * count + *(int*)callee->val] = true;
+        }
+    }
+    for (int i = 0; i < count; i++)
+        if (g.order[i] < 0) strongConnect(&g, i);
+
+    free(g.onStack);
+    free(g.stack);
+    free(g.low);
+    free(g.order);
+    free(g.calls);
+    freeMap(&names, NULL);
+    free(index);
+}
+
+int inlineFunctions(interCode** funcs, int count, root_t* candidates) {
+    int* scc = (int*)malloc(sizeof(int) * count);
+    bool* moved = (bool*)calloc(count, sizeof(bool));
+    int first = sccCount;
+    getComponents(funcs, count, scc);
+    // bottom-up, in source order within a component
+    for (int s = first; s < sccCount; s++) {
+        for (int i = 0; i < count; i++) {
+            if (scc[i] != s) continue;
+            enterFunction(funcs[i]);
+            int version = CodeVersion;
+            inlineCalls(funcs[i], candidates, s);
+            eliminateTailCalls(funcs[i]);
+            if (CodeVersion != version) funcs[i]->settled = false;
+            leaveFunction(funcs[i]);
+            candidate* c = newCandidate(funcs[i], s);
+            if (c)
+                remark(RM_ANALYSIS, "inline", funcs[i], 0,
+                       "candidate for inlining & cloning, cost %d",
+                       c->cost);
+            if (c) {
+                pruneParams(c);
+                put(candidates, funcs[i]->func_name, c);
+                moved[i] = true;
+            }
+        }
+    }
+
+    int left = 0;
+    for (int i = 0; i < count; i++)
+        if (!moved[i]) funcs[left++] = funcs[i];
+    free(moved);
+    free(scc);
+    return left;
+}
+
+static void markCall(interCode* call, bool resultUsed) {
+    map_t* found = get(&CalledTable, call->call.func_name);
+    calledFunc* f;
+    if (found == NULL) {
+        f = (calledFunc*)malloc(sizeof(calledFunc));
+        f->argc = 0;
+        for (interCode* arg = call->prev; arg->ic_type == ARG; arg = arg->prev)
+            f->argc++;
+        f->args = (operand*)malloc(sizeof(operand) * (f->argc + 1));
+        int k = 0;
+        for (interCode* arg = call->prev; k < f->argc; arg = arg->prev)
+            f->args[k++] = IS_CONST(arg->opr) ? arg->opr : nullOpr;
+        f->resultUsed = resultUsed;
+        put(&CalledTable, call->call.func_name, f);
+        return;
+    }
+    f = (calledFunc*)found->val;
+    f->resultUsed = f->resultUsed || resultUsed;
+    interCode* arg = call->prev;
+    for (int k = 0; k < f->argc; k++) {
+        if (arg->ic_type != ARG || !sameOpr(arg->opr, f->args[k]))
+            f->args[k] = nullOpr;
+        if (arg->ic_type == ARG) arg = arg->prev;
+    }
+}
+
+static void markCallees(interCode* head) {
+    int cnt = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next)
+        if (iter->ic_type == CALL) cnt++;
+    calleeList* list = (calleeList*)malloc(sizeof(calleeList));
+    list->cnt = 0;
+    list->names = (char(*)[32])malloc(sizeof(char[32]) * (cnt + 1));
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        if (iter->ic_type != CALL) continue;
+        bool seen = false;
+        for (int k = 0; k < list->cnt && !seen; k++)
+            seen = strcmp(list->names[k], iter->call.func_name) == 0;
+        if (!seen) strcpy(list->names[list->cnt++], iter->call.func_name);
+    }
+    put(&CallGraph, head->func_name, list);
+}
+
+void markCalls(interCode** funcs, int count) {
+    operand uses[3];
+    for (int i = 0; i < count; i++) {
+        interCode* head = funcs[i];
+        markCallees(head);
+        enterFunction(head);
+        // variables & temps read anywhere in the function
+        char* used = (char*)calloc(VarCount + TempCount + 1, sizeof(char));
+        for (interCode* iter = head->next; iter != head; iter = iter->next) {
+            int cnt = getCodeUse(iter, uses);
+            for (int k = 0; k < cnt; k++) used[getOprIndex(uses[k])] = 1;
+        }
+        used[0] = 0;
+        for (interCode* iter = head->next; iter != head; iter = iter->next)
+            if (iter->ic_type == CALL)
+                markCall(iter, used[getOprIndex(iter->call.dst)]);
+        free(used);
+        leaveFunction(head);
+    }
+}
+
+static void bindCalls(candidate* c) {
+    // the calls left are all calls there will be, every caller is
+    // emitted already: bind a parameter to the constant all of them
+    // pass, return #0 if none of them uses the result
+    map_t* found = get(&CalledTable, c->code->func_name);
+    if (found == NULL) return;
+    calledFunc* f = (calledFunc*)found->val;
+    interCode* head = c->code;
+    interCode* where = head;
+    while (where->next->ic_type == PARAM) where = where->next;
+    enterFunction(head);
+    int version = CodeVersion;
+    interCode* param = head->next;
+    for (int k = 0; k < f->argc && param->ic_type == PARAM; k++) {
+        if (IS_CONST(f->args[k]))
+            where = bindParam(head, where, param->opr, f->args[k]);
+        param = param->next;
+    }
+    for (interCode* iter = head->next; iter != head && !f->resultUsed;
+         iter = iter->next) {
+        if (iter->ic_type != RETURN_IC || IS_ZERO(iter->opr)) continue;
+        iter->opr = newOperand(CONST, 0);
+        touchCode(iter);
+    }
+    if (CodeVersion != version) head->settled = false;
+    leaveFunction(head);
+}
+
+static void freeCandidate(void* val) {
+    candidate* c = (candidate*)val;
+    free(c->dropped);
+    free(c->consts);
+    free(c);
+}
+
+static void freeCalledFunc(void* val) {
+    calledFunc* f = (calledFunc*)val;
+    free(f->args);
+    free(f);
+}
+
+static void freeCalleeList(void* val) {
+    calleeList* list = (calleeList*)val;
+    free(list->names);
+    free(list);
+}
+
+interCode** takeCandidates(root_t* candidates, root_t* reached, int* count) {
+    // walk the calls from main, through the functions emitted and
+    // the candidates, a candidate reached is kept
+    int total = 0;
+    for (map_t* node = map_first(candidates); node;
+         node = map_next(&(node->node))) {
+        total++;
+    }
+    int cap = 64, top = 0;
+    const char** stack = (const char**)malloc(sizeof(char*) * cap);
+    stack[top++] = "main";
+    while (top > 0) {
+        const char* name = stack[--top];
+        if (get(reached, name) != NULL) continue;
+        map_t* found = get(candidates, name);
+        // not a function, e.g. the profile's counter
+        if (found == NULL && get(&CallGraph, name) == NULL) continue;
+        put(reached, name, NULL);
+        if (found != NULL) {
+            candidate* c = (candidate*)found->val;
+            c->kept = true;
+            markCalls(&c->code, 1);
+        }
+        calleeList* list = (calleeList*)get(&CallGraph, name)->val;
+        if (top + list->cnt > cap) {
+            while (top + list->cnt > cap) cap *= 2;
+            stack = (const char**)realloc(stack, sizeof(char*) * cap);
+        }
+        for (int k = 0; k < list->cnt; k++) stack[top++] = list->names[k];
+    }
+    free(stack);
+
+    interCode** funcs = (interCode**)malloc(sizeof(interCode*) * (total + 1));
+    int left = 0;
+    for (map_t* node = map_first(candidates); node;
+         node = map_next(&(node->node))) {
+        candidate* c = (candidate*)node->val;
+        if (c->kept) {
+            bindCalls(c);
+            funcs[left++] = c->code;
+        } else {
+            freeInterCode(c->code);
+        }
+    }
+    funcs[left] = NULL;
+    freeMap(candidates, freeCandidate);
+    freeMap(&CalledTable, freeCalledFunc);
+    freeMap(&CallGraph, freeCalleeList);
+    *count = left;
+    return funcs;
+}
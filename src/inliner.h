@@ -0,0 +1,30 @@
+#ifndef __INLINER_H__
+#define __INLINER_H__
+
+#include <stdbool.h>
+
+#include "intercode.h"
+#include "map.h"
+
+// Inlining reads callees, allocates labels & renames operands,
+// everything here runs serially between the parallel passes
+
+// inline calls of funcs[0 .. count) to the candidates, callees before
+// callers by the strongly connected components of their calls, calls
+// not inlined that pass constants may go to a specialized clone, a
+// function's own calls in tail position become a jump to its start.
+// Small functions are moved into candidates <funcname, candidate> for
+// later callers, without the parameters they never use. Return how many
+// are left in funcs, in source order
+int inlineFunctions(interCode** funcs, int count, root_t* candidates);
+// remember the functions funcs still call & the constants they pass,
+// each function emitted is marked once
+void markCalls(interCode** funcs, int count);
+// every function main reaches through the calls marked & the
+// candidates goes into reached <funcname, NULL>. Return the candidates
+// among them, NULL terminated, with the constants all their calls
+// pass bound and results nobody uses dropped. The others and the map
+// are freed
+interCode** takeCandidates(root_t* candidates, root_t* reached, int* count);
+
+#endif
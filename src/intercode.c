@@ -5,10 +5,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "defuse.h"
+#include "stats.h"
+#include "worklist.h"
+
 // increase count when allocating a new item
 int LabelCount = 0;
-int VarCount = 0;
-int TempCount = 0;
+THREAD_LOCAL int VarCount = 0;
+THREAD_LOCAL int TempCount = 0;
+THREAD_LOCAL int CodeVersion = 0;
+THREAD_LOCAL int CodeLine = 0;
+
+// added to ids when printing, so that functions get distinct names
+static THREAD_LOCAL int var_name_base = 0;
+static THREAD_LOCAL int tmp_name_base = 0;
 
 // EQ, NE, LE, LT, GE, GT
 static const char* RelOps[] = {"==", "!=", "<=", "<", ">=", ">"};
@@ -110,6 +120,48 @@ int getCodeUse(interCode* code, operand* uses) {
     return cnt;
 }
 
+int getCodeOprSlots(interCode* code, operand** slots) {
+    // Note: slots should at least be operand*[3]
+    // collect every operand field of code, no matter def or use
+    int cnt = 0;
+    switch (code->ic_type) {
+        case PARAM:
+        case ARG:
+        case RETURN_IC:
+        case READ:
+        case WRITE:
+            slots[cnt++] = &(code->opr);
+            break;
+        case COND:
+            slots[cnt++] = &(code->cond.opr1);
+            slots[cnt++] = &(code->cond.opr2);
+            break;
+        case CALL:
+            slots[cnt++] = &(code->call.dst);
+            break;
+        case ASSIGN:
+            slots[cnt++] = &(code->assign.dst);
+            slots[cnt++] = &(code->assign.src1);
+            slots[cnt++] = &(code->assign.src2);
+            break;
+        default:
+            break;
+    }
+    return cnt;
+}
+
+void enterFunction(interCode* head) {
+    assert(head->ic_type == FUNCTION);
+    VarCount = head->var_cnt;
+    TempCount = head->tmp_cnt;
+}
+
+void leaveFunction(interCode* head) {
+    assert(head->ic_type == FUNCTION);
+    head->var_cnt = VarCount;
+    head->tmp_cnt = TempCount;
+}
+
 int getOprIndex(operand opr) {
     if (IS_TEMP(opr))
         return opr.tmp_id + VarCount;
@@ -169,10 +221,16 @@ interCode* copyInterCode(interCode* head) {
     assert(head);
     assert(head->ic_type == FUNCTION);
     interCode* ret = newFunctionCode(head->func_name);
+    ret->line = head->line;
+    ret->freq = head->freq;
+    ret->var_cnt = head->var_cnt;
+    ret->tmp_cnt = head->tmp_cnt;
     interCode* iter = head->next;
     interCode* cp;
     while (iter != head) {
         cp = newInterCode(iter->ic_type);
+        cp->line = iter->line;
+        cp->freq = iter->freq;
         switch (iter->ic_type) {
             case PARAM:
             case RETURN_IC:
@@ -206,12 +264,35 @@ interCode* copyInterCode(interCode* head) {
     return ret;
 }
 
+interCode* copyCode(interCode* code) {
+    assert(code->ic_type != FUNCTION);
+    interCode* ret = (interCode*)malloc(sizeof(interCode));
+    STAT_ADD(ST_CODES, 1);
+    STAT_ADD(ST_BYTES, sizeof(interCode));
+    *ret = *code;
+    ret->next = ret;
+    ret->prev = ret;
+    ret->def.idx = -1;
+    for (int i = 0; i < 3; i++) ret->uses[i].idx = -1;
+    ret->workPrev = NULL;
+    ret->workNext = NULL;
+    return ret;
+}
+
 interCode* newInterCode(int ic_type) {
     assert(ECODE <= ic_type && ic_type <= ASSIGN);
     interCode* ret = (interCode*)malloc(sizeof(interCode));
+    STAT_ADD(ST_CODES, 1);
+    STAT_ADD(ST_BYTES, sizeof(interCode));
     ret->ic_type = ic_type;
+    ret->line = CodeLine;
+    ret->freq = -1;
     ret->next = ret;
     ret->prev = ret;
+    ret->def.idx = -1;
+    for (int i = 0; i < 3; i++) ret->uses[i].idx = -1;
+    ret->workPrev = NULL;
+    ret->workNext = NULL;
     return ret;
 }
 
@@ -224,6 +305,9 @@ interCode* newLabelCode(int label_id) {
 interCode* newFunctionCode(const char* funcname) {
     interCode* ret = newInterCode(FUNCTION);
     strncpy(ret->func_name, funcname, 32);
+    ret->var_cnt = 0;
+    ret->tmp_cnt = 0;
+    ret->settled = false;
     return ret;
 }
 
@@ -289,20 +373,32 @@ interCode* mergeCode(interCode* head, interCode* codes) {
 void insertCodeAfter(interCode* where, interCode* codes) {
     assert(where);
     if (codes == NULL) return;
+    CodeVersion++;
     interCode* next = where->next;
     where->next = codes;
     next->prev = codes->prev;  // codes->tail
     codes->prev->next = next;
     codes->prev = where;
+    for (interCode* iter = codes; iter != next; iter = iter->next) {
+        if (iter->line == 0) iter->line = where->line;
+        if (iter->freq < 0) iter->freq = where->freq;
+        linkCode(iter);
+        queueCode(iter);
+    }
+    queueCode(next);
 }
 
 interCode* removeCodeItr(interCode* remove, bool next) {
     assert(remove != NULL);
     // assert(remove->ic_type != FUNCTION);
+    CodeVersion++;
+    unlinkCode(remove);
+    dequeueCode(remove);
     if (remove->next == remove) {
         free(remove);
         return NULL;
     }
+    queueCode(remove->next);
     remove->prev->next = remove->next;
     remove->next->prev = remove->prev;
     interCode* ret;
@@ -314,12 +410,92 @@ interCode* removeCodeItr(interCode* remove, bool next) {
     return ret;
 }
 
+void moveCodesAfter(interCode* where, interCode* first, interCode* last) {
+    assert(where && first && last);
+    if (where->next == first) return;
+    CodeVersion++;
+    // the codes keep their def-use links, only neighbours change
+    interCode* before = first->prev;
+    interCode* after = last->next;
+    before->next = after;
+    after->prev = before;
+    queueCode(after);
+
+    interCode* next = where->next;
+    where->next = first;
+    first->prev = where;
+    last->next = next;
+    next->prev = last;
+    queueCode(first);
+    queueCode(next);
+}
+
+void touchCode(interCode* code) {
+    assert(code != NULL);
+    CodeVersion++;
+    // its operands may be different now
+    unlinkCode(code);
+    linkCode(code);
+    queueCode(code);
+    queueCode(code->next);
+}
+
+bool sameOpr(operand opr1, operand opr2) {
+    // unlike oprEqual, address flags count as well
+    return opr1.opr_type == opr2.opr_type && opr1.var_id == opr2.var_id;
+}
+
+bool codeEqual(interCode* code1, interCode* code2) {
+    if (code1->ic_type != code2->ic_type) return false;
+    switch (code1->ic_type) {
+        case LABEL:
+        case GOTO:
+            return code1->label_id == code2->label_id;
+        case COND:
+            return code1->cond.op_type == code2->cond.op_type &&
+                   code1->cond.label_id == code2->cond.label_id &&
+                   sameOpr(code1->cond.opr1, code2->cond.opr1) &&
+                   sameOpr(code1->cond.opr2, code2->cond.opr2);
+        case ASSIGN:
+            return code1->assign.op_type == code2->assign.op_type &&
+                   sameOpr(code1->assign.dst, code2->assign.dst) &&
+                   sameOpr(code1->assign.src1, code2->assign.src1) &&
+                   sameOpr(code1->assign.src2, code2->assign.src2);
+        case CALL:
+            return sameOpr(code1->call.dst, code2->call.dst) &&
+                   strcmp(code1->call.func_name, code2->call.func_name) == 0;
+        case DEC:
+            return code1->dec.var_id == code2->dec.var_id &&
+                   code1->dec.size == code2->dec.size;
+        case FUNCTION:
+            return strcmp(code1->func_name, code2->func_name) == 0;
+        default:
+            return sameOpr(code1->opr, code2->opr);
+    }
+}
+
+void freeInterCode(interCode* head) {
+    // free a whole circular code list
+    interCode* iter = head->next;
+    while (iter != head) {
+        interCode* next = iter->next;
+        free(iter);
+        iter = next;
+    }
+    free(head);
+}
+
 void removeCode(interCode* remove) {
     assert(remove != NULL);
     assert(remove->ic_type != FUNCTION);
+    CodeVersion++;
+    unlinkCode(remove);
+    dequeueCode(remove);
     if (remove->next == remove) {
         free(remove);
+        return;
     }
+    queueCode(remove->next);
     remove->prev->next = remove->next;
     remove->next->prev = remove->prev;
     free(remove);
@@ -336,10 +512,10 @@ void operandToString(char* buffer, operand opr) {
             sprintf(buffer, "#%d", opr.const_value);
             break;
         case VARIABLE:
-            sprintf(buffer, "v%d", opr.var_id);
+            sprintf(buffer, "v%d", opr.var_id + var_name_base);
             break;
         case TEMP:
-            sprintf(buffer, "t%d", opr.tmp_id);
+            sprintf(buffer, "t%d", opr.tmp_id + tmp_name_base);
             break;
         default:
             assert(0);
@@ -412,7 +588,8 @@ void interCodeToString(char* buffer, interCode* code) {
             sprintf(buffer, "ARG %s", opr1_buffer);
             break;
         case DEC:
-            sprintf(buffer, "DEC v%d %d", code->dec.var_id, code->dec.size);
+            sprintf(buffer, "DEC v%d %d", code->dec.var_id + var_name_base,
+                    code->dec.size);
             break;
         case CALL:
             operandToString(opr1_buffer, code->call.dst);
@@ -486,15 +663,19 @@ void interCodeToString(char* buffer, interCode* code) {
     }
 }
 
-void interCodeToFile(interCode* codes, FILE* fp) {
+void interCodeToFile(interCode* codes, FILE* fp, int var_base, int tmp_base) {
     interCode* itr = codes;
     char buffer[256];
+    var_name_base = var_base;
+    tmp_name_base = tmp_base;
     do {
         interCodeToString(buffer, itr);
         fputs(buffer, fp);
         fputc('\n', fp);
         itr = itr->next;
     } while (itr != codes);
+    var_name_base = 0;
+    tmp_name_base = 0;
 }
 
 int isLeader(interCode* code, int* label) {
@@ -4,10 +4,19 @@
 #include <stdio.h>
 
 #include "arraynode.h"
+#include "threadpool.h"
 
 extern int LabelCount;
-extern int VarCount;
-extern int TempCount;
+// variables and temps are numbered densely per function,
+// these two describe the function currently being processed
+extern THREAD_LOCAL int VarCount;
+extern THREAD_LOCAL int TempCount;
+// increased on every change to the code, analyses stamped with
+// an older version are out of date
+extern THREAD_LOCAL int CodeVersion;
+// source line given to new codes, set while translating; codes made
+// by the passes take the line of the code they are inserted behind
+extern THREAD_LOCAL int CodeLine;
 
 enum block_sign {
     NORMAL_S = 0,
@@ -101,10 +110,24 @@ typedef struct _operand {
     // record current address level
 } operand;
 
+// one def or use of a variable/temp by a code, chained with
+// all the others of the same variable/temp, see defuse.h
+typedef struct _oprRef {
+    struct _interCode* code;
+    struct _oprRef* prev;
+    struct _oprRef* next;
+    int idx;  // getOprIndex of the operand, -1 if not chained
+} oprRef;
+
 typedef struct _interCode {
     int ic_type;
     union {
-        char func_name[32];
+        struct {
+            char func_name[32];
+            int var_cnt;  // count of variables in this function
+            int tmp_cnt;  // count of temps in this function
+            bool settled;  // unchanged since the local passes finished
+        };             // FUNCTION
         int label_id;  // LABEL & GOTO
         struct {
             int var_id;
@@ -127,8 +150,17 @@ typedef struct _interCode {
             int op_type;
         } assign;  // ASSIGN
     };
+    int line;  // in the source, 0 if unknown
+    // times its block ran in the profile, -1 without one, see profile.h
+    long long freq;
+    int pos;  // order in its function, numbered by useReplace
     struct _interCode* prev;
     struct _interCode* next;
+    oprRef def;
+    oprRef uses[3];
+    // peephole worklist, see worklist.h
+    struct _interCode* workPrev;
+    struct _interCode* workNext;
 } interCode;
 
 extern operand nullOpr;
@@ -144,11 +176,16 @@ operand allocVar();
 bool isDefCode(interCode* code);
 operand getCodeDst(interCode* code);
 int getCodeUse(interCode* code, operand* uses);
+int getCodeOprSlots(interCode* code, operand** slots);
+void enterFunction(interCode* head);
+void leaveFunction(interCode* head);
 int getArithOpType(const char* arithop);
 int reverseRelOp(int op_type);
 int getRelOpType(const char* relop);
 interCode* copyInterCode(interCode* head);
 interCode* newInterCode(int ic_type);
+// a single code, not linked to any list
+interCode* copyCode(interCode* code);
 interCode* newLabelCode(int label_id);
 interCode* newFunctionCode(const char* funcname);
 interCode* newGotoCode(int label_id);
@@ -161,9 +198,16 @@ interCode* mergeCode(interCode* head, interCode* codes);
 void insertCodeAfter(interCode* where, interCode* codes);
 interCode* removeCodeItr(interCode* remove, bool next);
 void removeCode(interCode* remove);
+// move the codes first .. last behind where
+void moveCodesAfter(interCode* where, interCode* first, interCode* last);
+// call after changing the operands, labels or type of code in place
+void touchCode(interCode* code);
+bool sameOpr(operand opr1, operand opr2);
+bool codeEqual(interCode* code1, interCode* code2);
+void freeInterCode(interCode* head);
 void operandToString(char* buffer, operand opr);
 void interCodeToString(char* buffer, interCode* code);
-void interCodeToFile(interCode* codes, FILE* fp);
+void interCodeToFile(interCode* codes, FILE* fp, int var_base, int tmp_base);
 void printSingleCode(interCode* code);
 int isLeader(interCode* code, int* label);
 
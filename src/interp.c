@@ -0,0 +1,560 @@
+#include "interp.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+
+static root_t Funcs = RB_ROOT;  // <funcname, runFunc>
+static int* labelAt = NULL;     // label_id -> instruction of a function
+static int labelCap = 0;
+
+runFunc* getRunFunc(const char* name) {
+    map_t* found = get(&Funcs, name);
+    if (found) return (runFunc*)found->val;
+    runFunc* f = (runFunc*)calloc(1, sizeof(runFunc));
+    put(&Funcs, name, f);
+    return f;
+}
+
+static int compareInt(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return x < y ? -1 : x > y;
+}
+
+// what lowering a function needs to resolve its operands
+typedef struct _lowering {
+    interCode* head;
+    runFunc* func;
+    int* arrayAt;  // var_id -> slot of its array, 0 if not declared
+} lowering;
+
+static int slotOf(lowering* l, operand opr) {
+    switch (OPR_TYPE(opr)) {
+        case CONST: {
+            int* found = (int*)bsearch(&opr.const_value, l->func->consts,
+                                       l->func->constCnt, sizeof(int),
+                                       compareInt);
+            assert(found);
+            return l->func->constBase + (int)(found - l->func->consts);
+        }
+        case VARIABLE:
+            return l->arrayAt[opr.var_id] ? l->arrayAt[opr.var_id]
+                                          : opr.var_id;
+        case TEMP:
+            return l->head->var_cnt + opr.tmp_id;
+        default:
+            // &v without an offset
+            return slotOf(l, zeroOpr);
+    }
+}
+
+static void layoutFrame(lowering* l) {
+    // constants sorted & unique behind the temps, then the arrays
+    interCode* head = l->head;
+    runFunc* f = l->func;
+    int cnt = 1;
+    for (interCode* iter = head->next; iter != head; iter = iter->next)
+        cnt += 3;
+    int* consts = (int*)malloc(sizeof(int) * cnt);
+    cnt = 0;
+    consts[cnt++] = 0;
+    operand* slots[3];
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        int oprCnt = getCodeOprSlots(iter, slots);
+        for (int i = 0; i < oprCnt; i++)
+            if (IS_CONST(*slots[i])) consts[cnt++] = slots[i]->const_value;
+    }
+    qsort(consts, cnt, sizeof(int), compareInt);
+    int unique = 0;
+    for (int i = 0; i < cnt; i++)
+        if (unique == 0 || consts[unique - 1] != consts[i])
+            consts[unique++] = consts[i];
+    f->consts = consts;
+    f->constCnt = unique;
+    f->constBase = head->var_cnt + head->tmp_cnt + 1;
+
+    l->arrayAt = (int*)calloc(head->var_cnt + 1, sizeof(int));
+    int size = f->constBase + unique;
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        if (iter->ic_type != DEC) continue;
+        l->arrayAt[iter->dec.var_id] = size;
+        size += iter->dec.size / 4;
+    }
+    f->frameSize = size;
+}
+
+static void lowerCond(lowering* l, interCode* code, runInst* inst) {
+    static const int flipped[] = {[EQ] = EQ, [NE] = NE, [LE] = GE,
+                                  [LT] = GT, [GE] = LE, [GT] = LT};
+    operand x = code->cond.opr1, y = code->cond.opr2;
+    int rel = code->cond.op_type;
+    if (IS_CONST(x) && !IS_CONST(y)) {
+        // #k < y  ==>  y > #k
+        x = code->cond.opr2;
+        y = code->cond.opr1;
+        rel = flipped[rel];
+    }
+    inst->a = slotOf(l, x);
+    if (IS_CONST(y)) {
+        inst->op = RUN_EQI + rel - EQ;
+        inst->b = y.const_value;
+    } else {
+        inst->op = RUN_EQ + rel - EQ;
+        inst->b = slotOf(l, y);
+    }
+    inst->target = code->cond.label_id;
+}
+
+static void lowerAssign(lowering* l, interCode* code, runInst* inst) {
+    int op = code->assign.op_type;
+    operand x = code->assign.src1, y = code->assign.src2;
+    if ((op == ADD || op == MUL) && IS_CONST(x) && !IS_CONST(y)) {
+        x = code->assign.src2;
+        y = code->assign.src1;
+    }
+    inst->a = slotOf(l, code->assign.dst);
+    inst->b = IS_CONST(x) && (op == AS || op == LSTAR) ? x.const_value
+                                                       : slotOf(l, x);
+    switch (op) {
+        case AS:
+            inst->op = IS_CONST(x) ? RUN_ASI : RUN_AS;
+            break;
+        case ADD:
+        case SUB:
+            if (IS_CONST(y)) {
+                inst->op = RUN_ADDI;
+                inst->c = op == ADD ? y.const_value
+                                    : (int)(0u - (unsigned)y.const_value);
+            } else {
+                inst->op = op == ADD ? RUN_ADD : RUN_SUB;
+                inst->c = slotOf(l, y);
+            }
+            break;
+        case MUL:
+            inst->op = IS_CONST(y) ? RUN_MULI : RUN_MUL;
+            inst->c = IS_CONST(y) ? y.const_value : slotOf(l, y);
+            break;
+        case DIVD:
+            if (IS_CONST(y) && y.const_value != 0 && y.const_value != -1) {
+                inst->op = RUN_DIVI;
+                inst->c = y.const_value;
+            } else {
+                inst->op = RUN_DIV;
+                inst->c = slotOf(l, y);
+            }
+            break;
+        case ADDR:
+            inst->op = RUN_ADDR;
+            inst->c = slotOf(l, y);
+            break;
+        case RSTAR:
+            inst->op = RUN_LOAD;
+            break;
+        case LSTAR:
+            inst->op = IS_CONST(x) ? RUN_STOREI : RUN_STORE;
+            break;
+        case LRSTAR:
+            inst->op = RUN_COPY;
+            break;
+        default:
+            assert(0);
+    }
+}
+
+static void lowerCode(lowering* l, interCode* code, runInst* inst) {
+    inst->a = inst->b = inst->c = inst->d = inst->e = 0;
+    switch (code->ic_type) {
+        case LABEL:
+        case DEC:
+            inst->op = RUN_NOP;
+            break;
+        case GOTO:
+            inst->op = RUN_GOTO;
+            inst->target = code->label_id;
+            break;
+        case COND:
+            lowerCond(l, code, inst);
+            break;
+        case ARG:
+        case RETURN_IC:
+        case WRITE:
+            inst->op = code->ic_type == ARG         ? RUN_ARG
+                       : code->ic_type == RETURN_IC ? RUN_RETURN
+                                                    : RUN_WRITE;
+            inst->a = slotOf(l, code->opr);
+            break;
+        case PARAM:
+        case READ:
+            inst->op = code->ic_type == PARAM ? RUN_PARAM : RUN_READ;
+            inst->a = slotOf(l, code->opr);
+            break;
+        case CALL:
+            inst->op = RUN_CALL;
+            inst->a = slotOf(l, code->call.dst);
+            inst->callee = getRunFunc(code->call.func_name);
+            break;
+        case ASSIGN:
+            lowerAssign(l, code, inst);
+            break;
+        default:
+            assert(0);
+    }
+}
+
+static void fuse(runInst* code, int cnt) {
+    // the second of a pair stays in place, nothing jumps to it as it
+    // has no LABEL in front of it
+    for (int i = 0; i + 1 < cnt; i++) {
+        runInst* x = &code[i];
+        runInst* y = &code[i + 1];
+        if (IS_RELOP(x->op) && y->op == RUN_GOTO) {
+            // IF .. GOTO L1, GOTO L2
+            x->op += RUN_EQ_J - RUN_EQ;
+            x->d = y->target;
+        } else if ((x->op == RUN_MUL || x->op == RUN_MULI) &&
+                   y->op == RUN_ADD && (y->b == x->a || y->c == x->a)) {
+            x->op = x->op == RUN_MUL ? RUN_MUL_ADD : RUN_MULI_ADD;
+            x->d = y->a;
+            x->e = y->b == x->a ? y->c : y->b;
+        } else if ((x->op == RUN_MUL || x->op == RUN_MULI) &&
+                   y->op == RUN_ADDR && y->c == x->a) {
+            x->op = x->op == RUN_MUL ? RUN_MUL_ADDR : RUN_MULI_ADDR;
+            x->d = y->a;
+            x->e = y->b;
+        }
+    }
+}
+
+static void lowerFunction(interCode* head) {
+    lowering l = {head, getRunFunc(head->func_name), NULL};
+    assert(l.func->code == NULL);
+    layoutFrame(&l);
+
+    int cnt = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        if (iter->ic_type == LABEL && iter->label_id >= labelCap) {
+            int cap = labelCap > 0 ? labelCap : 64;
+            while (cap <= iter->label_id) cap *= 2;
+            labelAt = (int*)realloc(labelAt, sizeof(int) * cap);
+            labelCap = cap;
+        }
+        if (iter->ic_type == LABEL) labelAt[iter->label_id] = cnt;
+        cnt++;
+    }
+    runInst* code = (runInst*)malloc(sizeof(runInst) * (cnt + 1));
+    cnt = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next)
+        lowerCode(&l, iter, &code[cnt++]);
+    code[cnt].op = RUN_END;
+    fuse(code, cnt);
+    for (int i = 0; i < cnt; i++) {
+        if (!IS_JUMP(code[i].op)) continue;
+        code[i].target = labelAt[code[i].target] + 1;
+        if (code[i].op >= RUN_EQ_J) code[i].d = labelAt[code[i].d] + 1;
+    }
+    l.func->code = code;
+    free(l.arrayAt);
+}
+
+void interpFunctions(interCode** codes) {
+    if (codes == NULL) return;
+    for (interCode** code = codes; *code != NULL; code++)
+        lowerFunction(*code);
+}
+
+// where a call returns to
+typedef struct _runFrame {
+    runInst* ret;   // the CALL
+    runInst* code;  // the caller's instructions
+    int* fp;
+    int dst;
+} runFrame;
+
+static void freeFunc(void* val) {
+    runFunc* f = (runFunc*)val;
+    free(f->code);
+    free(f->consts);
+    free(f);
+}
+
+void freeRunFuncs() {
+    freeMap(&Funcs, freeFunc);
+    free(labelAt);
+    labelAt = NULL;
+    labelCap = 0;
+}
+
+// merging the handlers' identical tails would leave them a single
+// shared indirect jump, which predicts far worse than one each
+__attribute__((optimize("no-crossjumping"))) int runInterp(FILE* in,
+                                                           FILE* out,
+                                                           long long* steps) {
+    // direct threaded: each instruction holds the address of its handler
+    // and every handler jumps straight to the next one's
+    static const void* const handlers[RUN_OP_CNT] = {
+#define RELOP_HANDLERS(rel, name)                         \
+    [RUN_EQ + (rel)-EQ] = &&name, [RUN_EQI + (rel)-EQ] = &&name##I, \
+    [RUN_EQ_J + (rel)-EQ] = &&name##_J, [RUN_EQI_J + (rel)-EQ] = &&name##I_J
+        [RUN_NOP] = &&nop,
+        [RUN_AS] = &&as,
+        [RUN_ASI] = &&asI,
+        [RUN_ADD] = &&add,
+        [RUN_ADDI] = &&addI,
+        [RUN_SUB] = &&sub,
+        [RUN_MUL] = &&mul,
+        [RUN_MULI] = &&mulI,
+        [RUN_DIV] = &&div,
+        [RUN_DIVI] = &&divI,
+        [RUN_ADDR] = &&addr,
+        [RUN_LOAD] = &&load,
+        [RUN_STORE] = &&store,
+        [RUN_STOREI] = &&storeI,
+        [RUN_COPY] = &&copy,
+        RELOP_HANDLERS(EQ, eq),
+        RELOP_HANDLERS(NE, ne),
+        RELOP_HANDLERS(LE, le),
+        RELOP_HANDLERS(LT, lt),
+        RELOP_HANDLERS(GE, ge),
+        RELOP_HANDLERS(GT, gt),
+        [RUN_GOTO] = &&jump,
+        [RUN_ARG] = &&arg,
+        [RUN_PARAM] = &&param,
+        [RUN_CALL] = &&call,
+        [RUN_RETURN] = &&ret,
+        [RUN_READ] = &&read,
+        [RUN_WRITE] = &&write,
+        [RUN_MUL_ADD] = &&mulAdd,
+        [RUN_MULI_ADD] = &&mulIAdd,
+        [RUN_MUL_ADDR] = &&mulAddr,
+        [RUN_MULI_ADDR] = &&mulIAddr,
+        [RUN_END] = &&end};
+#undef RELOP_HANDLERS
+    for (map_t* m = map_first(&Funcs); m; m = map_next(&m->node)) {
+        runFunc* f = (runFunc*)m->val;
+        if (f->code == NULL) continue;
+        for (runInst* inst = f->code;; inst++) {
+            inst->handler = handlers[inst->op];
+            if (inst->op == RUN_END) break;
+        }
+    }
+
+    int status = 1;
+    const char* error = NULL;
+    long long count = 0;
+    int* mem = (int*)calloc(MEM_WORDS, sizeof(int));
+    int argCap = 64, argCnt = 0;
+    int* args = (int*)malloc(sizeof(int) * argCap);
+    int frameCap = 64, frameCnt = 0;
+    runFrame* frames = (runFrame*)malloc(sizeof(runFrame) * frameCap);
+    runFunc* callee = getRunFunc("main");
+    runInst* code = NULL;  // of the running function
+    runInst* ip = NULL;
+    int* fp = mem;
+    int* sp = mem;
+    unsigned x, y;
+
+// each instruction is counted once it is done
+#define NEXT()                \
+    do {                      \
+        count++;              \
+        goto*(++ip)->handler; \
+    } while (0)
+#define JUMP(to)           \
+    do {                   \
+        count++;           \
+        ip = code + (to);  \
+        goto*ip->handler;  \
+    } while (0)
+#define FAIL(msg)    \
+    do {             \
+        error = msg; \
+        goto done;   \
+    } while (0)
+// a byte address to a word of memory
+#define WORD(addr, word)                                              \
+    do {                                                              \
+        word = (unsigned)(addr) >> 2;                                 \
+        if ((addr) < 0 || ((addr)&3) || word >= MEM_WORDS)            \
+            FAIL("illegal memory access");                            \
+    } while (0)
+
+    if (callee->code == NULL) FAIL("no main function");
+    count++;  // irsim starts on FUNCTION main, a CALL jumps past it
+    goto enter;
+
+// wrapping 32 bit arithmetic
+#define WRAP(x, op, y) ((int)((unsigned)(x)op(unsigned)(y)))
+#define ADDR_OF(slot) (int)((unsigned)(fp - mem + (slot)) * 4)
+
+nop:
+    NEXT();
+as:
+    fp[ip->a] = fp[ip->b];
+    NEXT();
+asI:
+    fp[ip->a] = ip->b;
+    NEXT();
+add:
+    fp[ip->a] = WRAP(fp[ip->b], +, fp[ip->c]);
+    NEXT();
+addI:
+    fp[ip->a] = WRAP(fp[ip->b], +, ip->c);
+    NEXT();
+sub:
+    fp[ip->a] = WRAP(fp[ip->b], -, fp[ip->c]);
+    NEXT();
+mul:
+    fp[ip->a] = WRAP(fp[ip->b], *, fp[ip->c]);
+    NEXT();
+mulI:
+    fp[ip->a] = WRAP(fp[ip->b], *, ip->c);
+    NEXT();
+div:
+    if (fp[ip->c] == 0) FAIL("division by zero");
+    if (fp[ip->b] == INT_MIN && fp[ip->c] == -1)
+        fp[ip->a] = INT_MIN;
+    else
+        fp[ip->a] = fp[ip->b] / fp[ip->c];
+    NEXT();
+divI:
+    fp[ip->a] = fp[ip->b] / ip->c;
+    NEXT();
+addr:
+    fp[ip->a] = WRAP(ADDR_OF(ip->b), +, fp[ip->c]);
+    NEXT();
+load:
+    WORD(fp[ip->b], x);
+    fp[ip->a] = mem[x];
+    NEXT();
+store:
+    WORD(fp[ip->a], x);
+    mem[x] = fp[ip->b];
+    NEXT();
+storeI:
+    WORD(fp[ip->a], x);
+    mem[x] = ip->b;
+    NEXT();
+copy:
+    WORD(fp[ip->a], x);
+    WORD(fp[ip->b], y);
+    mem[x] = mem[y];
+    NEXT();
+// a fused COND counts its GOTO too when not taken
+#define RELOP(name, rel)                               \
+    name:                                              \
+    if (fp[ip->a] rel fp[ip->b]) JUMP(ip->target);     \
+    NEXT();                                            \
+    name##I:                                           \
+    if (fp[ip->a] rel ip->b) JUMP(ip->target);         \
+    NEXT();                                            \
+    name##_J:                                          \
+    if (fp[ip->a] rel fp[ip->b]) JUMP(ip->target);     \
+    count++;                                           \
+    JUMP(ip->d);                                       \
+    name##I_J:                                         \
+    if (fp[ip->a] rel ip->b) JUMP(ip->target);         \
+    count++;                                           \
+    JUMP(ip->d);
+    RELOP(eq, ==)
+    RELOP(ne, !=)
+    RELOP(le, <=)
+    RELOP(lt, <)
+    RELOP(ge, >=)
+    RELOP(gt, >)
+#undef RELOP
+mulAdd:
+    fp[ip->a] = WRAP(fp[ip->b], *, fp[ip->c]);
+    fp[ip->d] = WRAP(fp[ip->a], +, fp[ip->e]);
+    count++;
+    ip++;
+    NEXT();
+mulIAdd:
+    fp[ip->a] = WRAP(fp[ip->b], *, ip->c);
+    fp[ip->d] = WRAP(fp[ip->a], +, fp[ip->e]);
+    count++;
+    ip++;
+    NEXT();
+mulAddr:
+    fp[ip->a] = WRAP(fp[ip->b], *, fp[ip->c]);
+    fp[ip->d] = WRAP(ADDR_OF(ip->e), +, fp[ip->a]);
+    count++;
+    ip++;
+    NEXT();
+mulIAddr:
+    fp[ip->a] = WRAP(fp[ip->b], *, ip->c);
+    fp[ip->d] = WRAP(ADDR_OF(ip->e), +, fp[ip->a]);
+    count++;
+    ip++;
+    NEXT();
+jump:
+    JUMP(ip->target);
+arg:
+    if (argCnt == argCap) {
+        argCap *= 2;
+        args = (int*)realloc(args, sizeof(int) * argCap);
+    }
+    args[argCnt++] = fp[ip->a];
+    NEXT();
+param:
+    if (argCnt == 0) FAIL("PARAM without an ARG");
+    fp[ip->a] = args[--argCnt];
+    NEXT();
+call:
+    callee = ip->callee;
+    if (callee->code == NULL) FAIL("call to an undefined function");
+    if (frameCnt == frameCap) {
+        frameCap *= 2;
+        frames = (runFrame*)realloc(frames, sizeof(runFrame) * frameCap);
+    }
+    frames[frameCnt++] = (runFrame){ip, code, fp, ip->a};
+    count++;
+    fp = sp;
+enter:
+    if (callee->frameSize > mem + MEM_WORDS - fp) FAIL("stack overflow");
+    sp = fp + callee->frameSize;
+    memcpy(fp + callee->constBase, callee->consts,
+           sizeof(int) * callee->constCnt);
+    code = ip = callee->code;
+    goto*ip->handler;
+ret:
+    count++;
+    if (frameCnt == 0) {
+        status = 0;
+        goto done;
+    }
+    x = fp[ip->a];
+    sp = fp;
+    frameCnt--;
+    ip = frames[frameCnt].ret;
+    code = frames[frameCnt].code;
+    fp = frames[frameCnt].fp;
+    fp[frames[frameCnt].dst] = (int)x;
+    goto*(++ip)->handler;
+read:
+    if (fscanf(in, "%d", &fp[ip->a]) != 1) FAIL("no more input to READ");
+    NEXT();
+write:
+    fprintf(out, "%d\n", fp[ip->a]);
+    NEXT();
+end:
+    FAIL("ran past the end of a function");
+
+done:
+#undef NEXT
+#undef JUMP
+#undef FAIL
+#undef WORD
+#undef WRAP
+#undef ADDR_OF
+    if (error) fprintf(stderr, "Runtime error: %s.\n", error);
+    fflush(out);
+    *steps = count;
+    free(mem);
+    free(args);
+    free(frames);
+    freeRunFuncs();
+    return status;
+}
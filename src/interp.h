@@ -0,0 +1,97 @@
+#ifndef __INTERP_H__
+#define __INTERP_H__
+
+#include <stdio.h>
+
+#include "intercode.h"
+
+// --run-ir: the optimized intercodes are run in place of writing them out
+
+#define MEM_WORDS (1 << 24)  // frames & arrays of all live calls, 64MB
+
+#define RELOPS 6  // EQ to GT
+
+// an op is specialized by its operands, I forms take an immediate in
+// place of the last slot, _J forms are a COND fused with the GOTO after
+// it & MUL forms fuse a multiply with the add using the product
+enum run_ops {
+    RUN_NOP,  // LABEL & DEC, counted as irsim does
+    RUN_AS,
+    RUN_ASI,
+    RUN_ADD,
+    RUN_ADDI,  // x := y - #k too
+    RUN_SUB,
+    RUN_MUL,
+    RUN_MULI,
+    RUN_DIV,
+    RUN_DIVI,  // neither by 0 nor -1
+    RUN_ADDR,
+    RUN_LOAD,    // x := *y
+    RUN_STORE,   // *x := y
+    RUN_STOREI,  // *x := #k
+    RUN_COPY,    // *x := *y
+    RUN_EQ,      // the relops in the order of op_types
+    RUN_EQI = RUN_EQ + RELOPS,
+    RUN_EQ_J = RUN_EQI + RELOPS,
+    RUN_EQI_J = RUN_EQ_J + RELOPS,
+    RUN_GOTO = RUN_EQI_J + RELOPS,
+    RUN_ARG,
+    RUN_PARAM,
+    RUN_CALL,
+    RUN_RETURN,
+    RUN_READ,
+    RUN_WRITE,
+    RUN_MUL_ADD,  // t := y * z, u := t + w
+    RUN_MULI_ADD,
+    RUN_MUL_ADDR,  // t := y * z, u := &v + t
+    RUN_MULI_ADDR,
+    RUN_END,  // past the last code of a function
+    RUN_OP_CNT
+};
+
+#define IS_RELOP(op) ((op) >= RUN_EQ && (op) < RUN_EQ_J)
+#define IS_JUMP(op) ((op) >= RUN_EQ && (op) <= RUN_GOTO)
+
+struct _runFunc;
+
+// a, b & c are slots or immediates in the order the operands are
+// written, jumps go to the instruction behind their LABEL
+typedef struct _runInst {
+    const void* handler;  // where the op is carried out, see runInterp
+    int op;
+    int a, b;
+    union {
+        int c;
+        int target;
+    };
+    union {
+        struct {
+            int d, e;  // the second half of a fused op
+        };
+        struct _runFunc* callee;
+    };
+} runInst;
+
+// slot 0 is unused, then variables, temps, constants & arrays
+typedef struct _runFunc {
+    runInst* code;  // NULL until the function is emitted
+    int frameSize;
+    int constBase;
+    int constCnt;
+    int* consts;   // copied into each new frame
+    int jitEntry;  // offset in the JIT's code, 0 until compiled, see jit.c
+} runFunc;
+
+// a lowerer, each function is lowered to a flat array of instructions
+// with operands resolved to frame slots & labels to instruction indexes
+void interpFunctions(interCode** codes);
+// run main, READ takes integers from in & WRITE prints to out, one per
+// line & steps counts the codes run the way irsim does. Return 0 once
+// main returns, 1 on a runtime error
+int runInterp(FILE* in, FILE* out, long long* steps);
+// the lowered function named name, empty until it is emitted
+runFunc* getRunFunc(const char* name);
+// free the lowered functions once they have been run
+void freeRunFuncs();
+
+#endif
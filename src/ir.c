@@ -1,24 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "ir.h"
 
+#include <setjmp.h>
+
+#include "inliner.h"
 #include "optimize.h"
+#include "profile.h"
+#include "semantic.h"
+#include "timing.h"
 
 #define _OPT_
 
-#define MAX_VAR_ID 10000
 #define MAX_ARG_CNT 5000
-
-static int funcCount = 0;
-
-root_t FuncTable = RB_ROOT;
-// Map <char*, interCode*> (funcname, funccode)
-root_t FuncOrder = RB_ROOT;
-root_t VarTable = RB_ROOT;
-// Map <char*, int> (varname, var_id)
-arrayNode* ArrayTable[MAX_VAR_ID];
+// functions optimized together, fixed so that the output
+// does not depend on the number of workers
+#define WINDOW_SIZE 16
+
+static int funcSeq = 0;  // function being translated, owner of bindings
+
+// functions are optimized & emitted while the rest is still parsed,
+// a window of them at a time so that the thread pool has work
+static FILE* streamOut = NULL;
+static emitter streamEmit = NULL;
+static lowerer streamLower = NULL;
+// output of each function emitted, spooled to a file as each window is
+// done & copied out at the end if main reaches it
+typedef struct _emitted {
+    char name[32];
+    long offset;  // in Spool
+    long len;
+} emitted;
+static FILE* Spool = NULL;
+static emitted* Emitted = NULL;
+static int emittedCnt = 0;
+static int emittedCap = 0;
+static interCode** window = NULL;  // translated, not yet optimized
+static int windowSize = 0;
+static root_t Candidates = RB_ROOT;
+// Map <char*, interCode*> (funcname, funccode) to inline into callers
+static jmp_buf failJump;       // where translation unwinds on an error
+static bool checkOnly = false;  // an error was met, only check the rest
+static int translateMsg = -1;   // the error that cannot be translated
+static int errorsBefore = 0;    // semantic errors before checkOnly
+static FILE* diagBuffer = NULL;  // diagnostics, held until parsing ends
+
+arrayNode** ArrayTable = NULL;
 // Barrel <int, arrayNode*> (var_id, array structure)
-bool ParamTable[MAX_VAR_ID];
+bool* ParamTable = NULL;
+// Barrel <int, bool> (var_id, is param)
+static int varTableCapacity = 0;
 
-void translateExtDef(treeNode* extdef_list);
+void translateExtDef(treeNode* extdef);
 void translateFunction(treeNode* function);
 interCode* translateFunDec(treeNode* funDec, char* buffer);
 interCode* translateCompSt(treeNode* compst);
@@ -35,33 +68,161 @@ interCode* translateCond(treeNode* exp, int true_label, int false_label);
 interCode* ensureEADDRInt(operand* opr);
 interCode* arrayAssign(operand dst, operand src);
 
-operand getOprByVarname(const char* varname) {
-    map_t* ret = get(&VarTable, varname);
-    if (ret == NULL) {
+void reserveVarTable(int var_id) {
+    // grow ArrayTable & ParamTable so that var_id can be indexed
+    if (var_id < varTableCapacity) return;
+    int capacity = varTableCapacity > 0 ? varTableCapacity : 64;
+    while (capacity <= var_id) capacity *= 2;
+    ArrayTable =
+        (arrayNode**)realloc(ArrayTable, sizeof(arrayNode*) * capacity);
+    ParamTable = (bool*)realloc(ParamTable, sizeof(bool) * capacity);
+    for (int i = varTableCapacity; i < capacity; i++) {
+        ArrayTable[i] = NULL;
+        ParamTable[i] = false;
+    }
+    varTableCapacity = capacity;
+}
+
+void resetVarTable() {
+    // variables are numbered from 1 again in each function
+    for (int i = 0; i <= VarCount && i < varTableCapacity; i++) {
+        if (ArrayTable[i]) freeArrayNodes(ArrayTable[i]);
+        ArrayTable[i] = NULL;
+        ParamTable[i] = false;
+    }
+    VarCount = 0;
+    TempCount = 0;
+}
+
+void checkPoint() {
+    // translation stops at the first error of the program,
+    // streamExtDef() then leaves the diagnostics to the checker
+    if (semanticErrors() == 0) return;
+    longjmp(failJump, 1);
+}
+
+type* checkedType(treeNode* exp) { return exp->exptype; }
+
+symbol* resolve(treeNode* id) {
+    // look the name up once, translating the node again reuses it
+    if (id->sym == NULL) id->sym = symbolFind(id->str);
+    return id->sym;
+}
+
+operand bindOperand(symbol* sym) {
+    // a variable gets its operand when first met in a function
+    assert(sym);
+    if (sym->owner != funcSeq) {
         operand opr = allocVar();
-        int* var_id = (int*)malloc(sizeof(int));
-        *var_id = opr.var_id;
-        put(&VarTable, varname, var_id);
-        return opr;
+        reserveVarTable(opr.var_id);
+        sym->var_id = opr.var_id;
+        sym->owner = funcSeq;
     }
-    return newOperand(VARIABLE, *(int*)ret->val);
+    return newOperand(VARIABLE, sym->var_id);
+}
+
+operand translateVar(treeNode* exp) {
+    // [Exp: ID]
+    treeNode* id = exp->childs[0];
+    symbol* sym = resolve(id);
+    exp->exptype = checkVariable(id, sym ? sym->t : NULL);
+    checkPoint();
+    return bindOperand(sym);
 }
 
-void addFunction(const char* funcname, interCode* codes) {
-    if (codes) {
-        put(&FuncTable, funcname, codes);
+static void emitFunctions(interCode** codes) {
+    if (streamLower) {
+        streamLower(codes);
+        return;
+    }
+    int cnt = 0;
+    while (codes[cnt] != NULL) cnt++;
+    if (emittedCnt + cnt > emittedCap) {
+        emittedCap = emittedCap > 0 ? emittedCap : 64;
+        while (emittedCnt + cnt > emittedCap) emittedCap *= 2;
+        Emitted = (emitted*)realloc(Emitted, sizeof(emitted) * emittedCap);
+    }
+    if (Spool == NULL) Spool = tmpfile();
+    assert(Spool);
+    // each function has its own stream so that they can be emitted
+    // in parallel, held in memory for this window only
+    FILE** outs = (FILE**)malloc(sizeof(FILE*) * (cnt + 1));
+    char** texts = (char**)malloc(sizeof(char*) * cnt);
+    size_t* lens = (size_t*)malloc(sizeof(size_t) * cnt);
+    for (int i = 0; i < cnt; i++) {
+        outs[i] = open_memstream(&texts[i], &lens[i]);
+        assert(outs[i]);
+    }
+    streamEmit(outs, codes);
+    for (int i = 0; i < cnt; i++) {
+        fclose(outs[i]);
+        emitted* e = &Emitted[emittedCnt + i];
+        strcpy(e->name, codes[i]->func_name);
+        e->offset = ftell(Spool);
+        e->len = lens[i];
+        fwrite(texts[i], 1, lens[i], Spool);
+        free(texts[i]);
+    }
+    emittedCnt += cnt;
+    free(outs);
+    free(texts);
+    free(lens);
+}
 
-        char* bufidx = (char*)malloc(sizeof(char) * 32);
-        char* bufname = (char*)malloc(sizeof(char) * 64);
-        sprintf(bufidx, "%d", funcCount++);
-        strcpy(bufname, funcname);
-        put(&FuncOrder, bufidx, bufname);
+static void writeReached(root_t* reached) {
+    // in the order they were emitted, NULL drops them all
+    char buffer[4096];
+    for (int i = 0; reached && i < emittedCnt; i++) {
+        emitted* e = &Emitted[i];
+        if (get(reached, e->name) == NULL) continue;
+        fseek(Spool, e->offset, SEEK_SET);
+        for (long left = e->len; left > 0;) {
+            size_t want = left < (long)sizeof(buffer) ? left : sizeof(buffer);
+            size_t len = fread(buffer, 1, want, Spool);
+            assert(len > 0);
+            fwrite(buffer, 1, len, streamOut);
+            left -= len;
+        }
     }
+    if (Spool) fclose(Spool);
+    Spool = NULL;
+    free(Emitted);
+    Emitted = NULL;
+    emittedCnt = emittedCap = 0;
+}
+
+void flushWindow() {
+    // the passes insert codes at the lines of their neighbours
+    CodeLine = 0;
+    if (windowSize == 0) return;
+#ifdef _OPT_
+    phaseBegin(PH_OPTIMIZE);
+    windowSize = optimize(window, windowSize, &Candidates);
+    phaseEnd(PH_OPTIMIZE);
+#endif
+    markCalls(window, windowSize);
+    window[windowSize] = NULL;
+    phaseBegin(PH_EMIT);
+    emitFunctions(window);
+    phaseEnd(PH_EMIT);
+    for (int i = 0; i < windowSize; i++) freeInterCode(window[i]);
+    windowSize = 0;
+}
+
+void addFunction(interCode* codes) {
+    // blocks are numbered for the profile before any pass moves them
+    if (ProfileGenerate)
+        instrumentBlocks(codes);
+    else if (ProfileMax > 0)
+        annotateBlocks(codes);
+    window[windowSize++] = codes;
+    if (windowSize >= WINDOW_SIZE) flushWindow();
 }
 
 void translateError(int msg_id) {
-    fprintf(stderr, "Cannot translate: %s\n", errmsgT[msg_id]);
-    exit(1);
+    // semantic errors in the rest of program come first
+    translateMsg = msg_id;
+    longjmp(failJump, 1);
 }
 
 void checkSpecifier(treeNode* specifier) {
@@ -92,8 +253,7 @@ operand handleArrayDec(treeNode* vardec) {
         head = insertArrayNode(head, newArrayNode(size));
         vardec = vardec->childs[0];
     }
-    operand ret = getOprByVarname(vardec->childs[0]->str);
-    assert(ret.var_id < MAX_VAR_ID);
+    operand ret = bindOperand(resolve(vardec->childs[0]));
 
     SET_RADDR(ret);                       // set range-addr
     setArrayNodeVarId(head, ret.var_id);  // set node->var_id
@@ -103,31 +263,25 @@ operand handleArrayDec(treeNode* vardec) {
     return ret;
 }
 
-void translateExtDef(treeNode* extdef_list) {
-    while (extdef_list->childs != NULL) {
-        // [ExtDefList: ExtDef ExtDefList]
-        treeNode* extdef = extdef_list->childs[0];
-        treeNode* next_list = extdef_list->childs[1];
-
-        treeNode* specifier = extdef->childs[0];
-        checkSpecifier(specifier);
+void translateExtDef(treeNode* extdef) {
+    treeNode* specifier = extdef->childs[0];
+    checkSpecifier(specifier);
 
-        switch (extdef->childs[1]->token) {
-            case SEMI:
-                // [ExtDef: Specifier SEMI]
-                break;
-            case ExtDecList:
-                // [ExtDef: Specifier ExtDecList SEMI]
-                break;
-            case FunDec:
-                // [ExtDef: Specifier FunDec CompSt]
-                translateFunction(extdef);
-                break;
-            default:
-                assert(0);
-        }
-
-        extdef_list = next_list;
+    switch (extdef->childs[1]->token) {
+        case SEMI:
+            // [ExtDef: Specifier SEMI]
+            break;
+        case ExtDecList:
+            // [ExtDef: Specifier ExtDecList SEMI]
+            parseExtDec(extdef->childs[1], newType(IntType));
+            checkPoint();
+            break;
+        case FunDec:
+            // [ExtDef: Specifier FunDec CompSt]
+            translateFunction(extdef);
+            break;
+        default:
+            assert(0);
     }
 }
 
@@ -137,10 +291,17 @@ void translateFunction(treeNode* function) {
     treeNode* compst = function->childs[2];
 
     char funcname[32];
+    funcSeq++;
+    resetVarTable();
+    // insert the function, then open its scope with params inside
+    parseFuncDec(funDec, newType(IntType));
+    checkPoint();
     interCode* codes = translateFunDec(funDec, funcname);
     interCode* append = translateCompSt(compst);
+    delScope();
     codes = mergeCode(codes, append);
-    addFunction(funcname, codes);
+    leaveFunction(codes);
+    addFunction(codes);
 }
 
 interCode* translateFunDec(treeNode* funDec, char* buffer) {
@@ -148,6 +309,7 @@ interCode* translateFunDec(treeNode* funDec, char* buffer) {
     treeNode* id = funDec->childs[0];
     strcpy(buffer, id->str);
 
+    CodeLine = id->lineNum;
     interCode* codes = newFunctionCode(id->str);
     interCode* varlist = NULL;
     if (funDec->childCnt == 4)  // has VarList
@@ -169,7 +331,7 @@ interCode* translateVarList(treeNode* varlist) {
         checkSpecifier(specifier);
         // [VarDec: ID]
         if (vardec->childCnt == 1) {
-            var = getOprByVarname(vardec->childs[0]->str);
+            var = bindOperand(resolve(vardec->childs[0]));
         } else {
             var = handleArrayDec(vardec);
         }
@@ -226,6 +388,7 @@ interCode* translateDef(treeNode* def) {
     // [Def: Specifier DecList SEMI]
     interCode* ret = NULL;
     checkSpecifier(def->childs[0]);
+    type* this = newType(IntType);
     treeNode* declist = def->childs[1];
 
     // [DecList: Dec <COMMA DecList>]
@@ -233,11 +396,16 @@ interCode* translateDef(treeNode* def) {
     interCode* dec_code = NULL;
     while (true) {
         dec = declist->childs[0];
+        CodeLine = dec->lineNum;
+        type* vartype = declareVar(dec->childs[0], this);
+        checkPoint();
 
         // [Dec: VarDec <ASSIGNOP Exp>]
-        if (dec->childCnt == 3)
+        if (dec->childCnt == 3) {
             dec_code = translateVarDec(dec->childs[0], dec->childs[2]);
-        else  // childCnt == 1
+            checkInit(dec, dec->childs[2]->exptype, vartype);
+            checkPoint();
+        } else  // childCnt == 1
             dec_code = translateVarDec(dec->childs[0], NULL);
         ret = mergeCode(ret, dec_code);
 
@@ -249,7 +417,18 @@ interCode* translateDef(treeNode* def) {
     return ret;
 }
 
+interCode* translateStmtCodes(treeNode* stmt);
+
 interCode* translateStmt(treeNode* stmt) {
+    // codes an enclosing statement makes after this one are its own
+    int line = CodeLine;
+    CodeLine = stmt->lineNum;
+    interCode* ret = translateStmtCodes(stmt);
+    CodeLine = line;
+    return ret;
+}
+
+interCode* translateStmtCodes(treeNode* stmt) {
     interCode* ret = NULL;
     switch (stmt->childs[0]->token) {
         case Exp:
@@ -257,11 +436,16 @@ interCode* translateStmt(treeNode* stmt) {
             return translateExp(stmt->childs[0], &nullOpr);
         case CompSt:
             // [Stmt: Compst]
-            return translateCompSt(stmt->childs[0]);
+            newScope();
+            ret = translateCompSt(stmt->childs[0]);
+            delScope();
+            return ret;
         case RETURN: {
             // [Stmt: RETURN Exp SEMI]
             operand ret_temp = allocTemp();
             interCode* exp_code = translateExp(stmt->childs[1], &ret_temp);
+            checkReturn(stmt, stmt->childs[1]->exptype, newType(IntType));
+            checkPoint();
             interCode* ret_code = newSingleOprCode(RETURN_IC, ret_temp);
             exp_code = mergeCode(exp_code, ensureEADDRInt(&ret_temp));
             return mergeCode(exp_code, ret_code);
@@ -271,6 +455,8 @@ interCode* translateStmt(treeNode* stmt) {
             int t_lbl = allocLabel();
             int f_lbl = allocLabel();
             interCode* cond_code = translateCond(stmt->childs[2], t_lbl, f_lbl);
+            checkCond(stmt->childs[2], stmt->childs[2]->exptype);
+            checkPoint();
             interCode* stmt_code = translateStmt(stmt->childs[4]);
             if (stmt->childCnt == 7) {
                 int exit_lbl = allocLabel();
@@ -302,6 +488,8 @@ interCode* translateStmt(treeNode* stmt) {
             // out:
             interCode* cond_code =
                 translateCond(stmt->childs[2], loop_lbl, out_lbl);
+            checkCond(stmt->childs[2], stmt->childs[2]->exptype);
+            checkPoint();
             interCode* cond_code2 =
                 translateCond(stmt->childs[2], loop_lbl, out_lbl);
             interCode* loop_code = translateStmt(stmt->childs[4]);
@@ -320,7 +508,7 @@ interCode* translateStmt(treeNode* stmt) {
 interCode* translateVarDec(treeNode* vardec, treeNode* exp) {
     // [VarDec: ID]
     if (vardec->childCnt == 1) {
-        operand var = getOprByVarname(vardec->childs[0]->str);
+        operand var = bindOperand(resolve(vardec->childs[0]));
         if (exp != NULL) {
             interCode* codes = translateExp(exp, &var);
             if (ArrayTable[var.var_id] == NULL)
@@ -353,13 +541,14 @@ interCode* translateExp(treeNode* exp, operand* dst) {
         // [Exp: ID / INT / FLOAT]
         switch (exp->childs[0]->token) {
             case INT:
+                exp->exptype = newType(IntType);
                 src = newOperand(CONST, atoi(exp->childs[0]->str));
                 break;
             case FLOAT:
                 translateError(HAS_FLOAT);
                 break;
             case ID:
-                src = getOprByVarname(exp->childs[0]->str);
+                src = translateVar(exp);
                 if (ArrayTable[src.var_id] != NULL) {
                     dst->level = ArrayTable[src.var_id];
                     SET_RADDR(*dst);
@@ -376,28 +565,38 @@ interCode* translateExp(treeNode* exp, operand* dst) {
         return newAssignCode(AS, *dst, src, nullOpr);
     } else if (exp->childs[0]->token == LP) {
         // [Exp: LP Exp RP]
-        return translateExp(exp->childs[1], dst);
+        interCode* codes = translateExp(exp->childs[1], dst);
+        exp->exptype = exp->childs[1]->exptype;
+        return codes;
     } else if (exp->childs[0]->token == MINUS) {
         // [Exp: MINUS Exp]
         src = allocTemp();
         interCode* code1 = translateExp(exp->childs[1], &src);
+        exp->exptype = checkOperator(exp, exp->childs[1]->exptype, NULL);
+        checkPoint();
         code1 = mergeCode(code1, ensureEADDRInt(&src));
         interCode* code2 = newAssignCode(SUB, *dst, zeroOpr, src);
         return mergeCode(code1, code2);
     } else if (exp->childs[0]->token == ID) {
         // [Exp: ID LP <Args> RP]
-        interCode* io_code = translateIO(exp, *dst);
-        if (io_code != NULL) return io_code;
-
-        interCode* call_code;
-        if (IS_EOPR(*dst))
-            call_code = newCallCode(allocTemp(), exp->childs[0]->str);
-        else
-            call_code = newCallCode(*dst, exp->childs[0]->str);
-        interCode* arg_code = NULL;
-        if (exp->childCnt == 4)  // has Args
-            arg_code = translateArgs(exp->childs[2]);
-        return mergeCode(arg_code, call_code);
+        symbol* func = resolve(exp->childs[0]);
+        interCode* ret = translateIO(exp, *dst);
+        if (ret == NULL) {
+            interCode* call_code;
+            if (IS_EOPR(*dst))
+                call_code = newCallCode(allocTemp(), exp->childs[0]->str);
+            else
+                call_code = newCallCode(*dst, exp->childs[0]->str);
+            call_code->line = exp->lineNum;
+            interCode* arg_code = NULL;
+            if (exp->childCnt == 4)  // has Args
+                arg_code = translateArgs(exp->childs[2]);
+            ret = mergeCode(arg_code, call_code);
+        }
+        // args have been checked while translated
+        exp->exptype = checkCall(exp, func ? func->t : NULL, checkedType);
+        checkPoint();
+        return ret;
     } else {
         switch (exp->childs[1]->token) {
             case ASSIGNOP: {
@@ -408,8 +607,10 @@ interCode* translateExp(treeNode* exp, operand* dst) {
                     // var := exp
                     // array := exp
                     interCode* ret = NULL;
-                    operand lvalue =
-                        getOprByVarname(exp->childs[0]->childs[0]->str);
+                    operand lvalue = translateVar(exp->childs[0]);
+                    exp->exptype = checkOperator(exp, exp->childs[0]->exptype,
+                                                 exp->childs[2]->exptype);
+                    checkPoint();
                     if (ArrayTable[lvalue.var_id] != NULL) {
                         SET_RADDR(lvalue);
                         lvalue.level = ArrayTable[lvalue.var_id];
@@ -453,6 +654,9 @@ interCode* translateExp(treeNode* exp, operand* dst) {
                 } else {
                     operand laddr = allocTemp();
                     interCode* get_laddr = translateExp(exp->childs[0], &laddr);
+                    exp->exptype = checkOperator(exp, exp->childs[0]->exptype,
+                                                 exp->childs[2]->exptype);
+                    checkPoint();
                     get_src = mergeCode(get_src, get_laddr);
                     interCode* assign = NULL;
                     if (IS_RADDR(laddr) && IS_RADDR(src)) {
@@ -483,6 +687,9 @@ interCode* translateExp(treeNode* exp, operand* dst) {
                 operand src2 = allocTemp();
                 interCode* code1 = translateExp(exp->childs[0], &src1);
                 interCode* code2 = translateExp(exp->childs[2], &src2);
+                exp->exptype = checkOperator(exp, exp->childs[0]->exptype,
+                                             exp->childs[2]->exptype);
+                checkPoint();
                 code1 = mergeCode(code1, ensureEADDRInt(&src1));
                 code2 = mergeCode(code2, ensureEADDRInt(&src2));
                 int op_type = getArithOpType(exp->childs[1]->str);
@@ -515,6 +722,9 @@ interCode* translateExp(treeNode* exp, operand* dst) {
                 operand index = allocTemp();
                 interCode* base_code = translateExp(exp->childs[0], &base);
                 interCode* index_code = translateExp(exp->childs[2], &index);
+                exp->exptype = checkOperator(exp, exp->childs[0]->exptype,
+                                             exp->childs[2]->exptype);
+                checkPoint();
                 index_code = mergeCode(index_code, ensureEADDRInt(&index));
                 // index := index * width
                 interCode* get_bias = newAssignCode(
@@ -617,6 +827,9 @@ interCode* translateCond(treeNode* exp, int true_label, int false_label) {
             operand t2 = allocTemp();
             interCode* t1_code = translateExp(exp->childs[0], &t1);
             interCode* t2_code = translateExp(exp->childs[2], &t2);
+            exp->exptype = checkOperator(exp, exp->childs[0]->exptype,
+                                         exp->childs[2]->exptype);
+            checkPoint();
             t1_code = mergeCode(t1_code, ensureEADDRInt(&t1));
             t2_code = mergeCode(t2_code, ensureEADDRInt(&t2));
             int op_type = getRelOpType(exp->childs[1]->str);
@@ -628,7 +841,10 @@ interCode* translateCond(treeNode* exp, int true_label, int false_label) {
             return ret;
         } else if (exp->childs[0]->token == NOT) {
             // [Exp: NOT Exp]
-            return translateCond(exp->childs[1], false_label, true_label);
+            ret = translateCond(exp->childs[1], false_label, true_label);
+            exp->exptype = checkOperator(exp, exp->childs[1]->exptype, NULL);
+            checkPoint();
+            return ret;
         } else if (exp->childs[1]->token == AND) {
             // [Exp: Exp AND Exp]
             int next_exp = allocLabel();
@@ -636,6 +852,9 @@ interCode* translateCond(treeNode* exp, int true_label, int false_label) {
                 translateCond(exp->childs[0], next_exp, false_label);
             interCode* code2 =
                 translateCond(exp->childs[2], true_label, false_label);
+            exp->exptype = checkOperator(exp, exp->childs[0]->exptype,
+                                         exp->childs[2]->exptype);
+            checkPoint();
             interCode* label_code = newLabelCode(next_exp);
             ret = mergeCode(ret, code1);
             ret = mergeCode(ret, label_code);
@@ -648,6 +867,9 @@ interCode* translateCond(treeNode* exp, int true_label, int false_label) {
                 translateCond(exp->childs[0], true_label, next_exp);
             interCode* code2 =
                 translateCond(exp->childs[2], true_label, false_label);
+            exp->exptype = checkOperator(exp, exp->childs[0]->exptype,
+                                         exp->childs[2]->exptype);
+            checkPoint();
             interCode* label_code = newLabelCode(next_exp);
             ret = mergeCode(ret, code1);
             ret = mergeCode(ret, label_code);
@@ -747,55 +969,98 @@ interCode* arrayAssign(operand dst, operand src) {
     return ret;
 }
 
-interCode** interCodeGenerate() {
-    if (root == NULL) return NULL;
-
-    // initialize
-    for (int i = 0; i < MAX_VAR_ID; i++) {
-        ArrayTable[i] = NULL;
-        ParamTable[i] = false;
-    }
-
-    // translate
-    treeNode* extdef_list = root->childs[0];
-    translateExtDef(extdef_list);
-
-#ifdef _OPT_
-    optimize(&FuncTable);
-#endif
-
-    interCode** codes =
-        (interCode**)malloc(sizeof(interCode*) * (funcCount + 1));
-    int ret_idx = 0;
-    for (int i = 0; i < funcCount; i++) {
-        char buf[32];
-        sprintf(buf, "%d", i);
-
-        // FuncOrder <func_id: int, func_name: string>
-        map_t* ret = get(&FuncOrder, buf);
-        if (ret == NULL) continue;
-        char* funcname = ret->val;
+void beginStream(FILE* fp, emitter emit) {
+    streamOut = fp;
+    streamEmit = emit;
+    window = (interCode**)malloc(sizeof(interCode*) * (WINDOW_SIZE + 1));
+    // check while translating, a single walk over the tree
+    setSemanticQuiet(true);
+    newScope();  // global scope
+    declareBuiltins();
+}
 
-#ifdef _OPT_
-        map_t* is_inline = get(&InlineTable, funcname);
-        if (is_inline != NULL && *(bool*)is_inline->val == true) continue;
-#endif
+void beginRunStream(lowerer lower) {
+    streamLower = lower;
+    beginStream(NULL, NULL);
+}
 
-        map_t* func = get(&FuncTable, funcname);
-        if (func == NULL) continue;
-        interCode* code = (interCode*)func->val;
+void streamExtDef(treeNode* extdef) {
+    // nothing is translated after a syntax error
+    if (preverr != -1) return;
 
-        codes[ret_idx++] = code;
+    if (!checkOnly) {
+        int mark = tableMark();
+        phaseBegin(PH_TRANSLATE);
+        if (setjmp(failJump) == 0) {
+            translateExtDef(extdef);
+        } else {
+            // forget what the failed ExtDef declared,
+            // the checker declares it again while reporting
+            tableRollback(mark);
+            checkOnly = true;
+            errorsBefore = semanticErrors();
+            diagBuffer = tmpfile();
+            setSemanticOutput(diagBuffer);
+            setSemanticQuiet(false);
+        }
+        phaseEnd(PH_TRANSLATE);
     }
-    codes[ret_idx++] = NULL;
+    if (checkOnly) {
+        phaseBegin(PH_SEMANTIC);
+        checkExtDef(extdef);
+        phaseEnd(PH_SEMANTIC);
+    }
+    pruneTree(extdef);
+}
 
-    return codes;
+bool endStream() {
+    bool ok = preverr == -1 && !checkOnly;
+    if (ok) {
+        flushWindow();
+        // inline candidates main reaches still have to be emitted,
+        // then everything main reaches is written
+        root_t reached = RB_ROOT;
+        phaseBegin(PH_OPTIMIZE);
+        interCode** rest = finishCandidates(&Candidates, &reached);
+        phaseEnd(PH_OPTIMIZE);
+        phaseBegin(PH_EMIT);
+        emitFunctions(rest);
+        writeReached(&reached);
+        phaseEnd(PH_EMIT);
+        for (interCode** code = rest; *code != NULL; code++)
+            freeInterCode(*code);
+        free(rest);
+        freeMap(&reached, NULL);
+    } else {
+        writeReached(NULL);
+    }
+    if (diagBuffer && preverr == -1) {
+        rewind(diagBuffer);
+        char buffer[4096];
+        size_t len;
+        while ((len = fread(buffer, 1, sizeof(buffer), diagBuffer)) > 0)
+            fwrite(buffer, 1, len, stderr);
+    }
+    if (diagBuffer) fclose(diagBuffer);
+    if (translateMsg >= 0 && preverr == -1 &&
+        semanticErrors() == errorsBefore)
+        fprintf(stderr, "Cannot translate: %s\n", errmsgT[translateMsg]);
+    clearScope();
+    free(window);
+    return ok;
 }
 
-void interCodeOutput(FILE* fp, interCode** codes) {
+void interCodeOutput(FILE** outs, interCode** codes) {
     if (codes == NULL) return;
 
-    for (interCode** code = codes; *code != NULL; code++) {
-        interCodeToFile(*code, fp);
+    // ids are dense per function, shift them so that
+    // each function owns distinct names in the output,
+    // later calls go on from where the last one stopped
+    static int var_base = 0;
+    static int tmp_base = 0;
+    for (int i = 0; codes[i] != NULL; i++) {
+        interCodeToFile(codes[i], outs[i], var_base, tmp_base);
+        var_base += codes[i]->var_cnt;
+        tmp_base += codes[i]->tmp_cnt;
     }
 }
\ No newline at end of file
@@ -8,8 +8,21 @@
 #include "intercode.h"
 #include "map.h"
 
-// use this to get an array of interCode*, ends with NULL
-interCode** interCodeGenerate();
-void interCodeOutput(FILE* fp, interCode** codes);
+// receives functions ready for output, an array ending with NULL,
+// and writes codes[i] to outs[i]
+typedef void (*emitter)(FILE** outs, interCode** codes);
+// receives them to be run in place of written out, see interp.h
+typedef void (*lowerer)(interCode** codes);
+
+// translate each ExtDef as soon as it is parsed, functions are
+// optimized & passed to emit a few at a time. Their output is held
+// until the end, only functions main reaches are written to fp
+void beginStream(FILE* fp, emitter emit);
+// --run-ir: the functions go to lower instead of an emitter
+void beginRunStream(lowerer lower);
+void streamExtDef(treeNode* extdef);
+// emit what is left & report errors, return false if any
+bool endStream();
+void interCodeOutput(FILE** outs, interCode** codes);
 
 #endif
\ No newline at end of file
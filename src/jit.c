@@ -0,0 +1,467 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS & MAP_NORESERVE
+
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define JIT_STACK (1 << 28)        // native stack, 16 bytes a call
+#define JIT_STACK_SPARE (1 << 20)  // kept for the READ/WRITE callbacks
+
+enum jit_errors {
+    ERR_MEM = 1,
+    ERR_DIV,
+    ERR_STACK,
+    ERR_PARAM,
+    ERR_ARGS,
+    ERR_READ,
+    ERR_UNDEFINED,
+    ERR_END,
+    ERR_CNT
+};
+
+static const char* const errorMsg[ERR_CNT] = {
+    [ERR_MEM] = "illegal memory access",
+    [ERR_DIV] = "division by zero",
+    [ERR_STACK] = "stack overflow",
+    [ERR_PARAM] = "PARAM without an ARG",
+    [ERR_ARGS] = "too many ARGs",
+    [ERR_READ] = "no more input to READ",
+    [ERR_UNDEFINED] = "call to an undefined function",
+    [ERR_END] = "ran past the end of a function"};
+
+// while compiled code runs, registers hold
+//   rbx: frame of the running function   rbp: top of the ARG stack
+//   r12: mem   r13: end of mem   r14: the jitCtx   r15: count
+typedef struct _jitCtx {
+    void* savedSp;  // of the C caller
+    void* stackTop;
+    void* stackLimit;
+    int* mem;
+    int* memEnd;
+    int* args;
+    int* argsEnd;
+    long long count;
+    int error;
+    int (*read)(struct _jitCtx*, int*);
+    void (*write)(struct _jitCtx*, int);
+    FILE* in;
+    FILE* out;
+} jitCtx;
+
+// a rel32 to patch once its target is known
+typedef struct _jitFixup {
+    int at;
+    union {
+        int inst;       // of the function being compiled
+        runFunc* func;  // its entry
+    };
+} jitFixup;
+
+typedef struct _jitBuf {
+    unsigned char* code;
+    int size, cap;
+    int errorAt[ERR_CNT];
+    int* instAt;  // offset of each instruction of the function
+    int instCap;
+    jitFixup* jumps;
+    int jumpCnt, jumpCap;
+    jitFixup* calls;
+    int callCnt, callCap;
+    runFunc** queue;  // functions called but not compiled yet
+    int queueCnt, queueCap;
+} jitBuf;
+
+static void* grow(void* array, int* cap, int need, size_t size) {
+    if (need <= *cap) return array;
+    int cap2 = *cap > 0 ? *cap : 16;
+    while (cap2 < need) cap2 *= 2;
+    *cap = cap2;
+    return realloc(array, size * cap2);
+}
+
+static void reserve(jitBuf* j, int len) {
+    j->code = (unsigned char*)grow(j->code, &j->cap, j->size + len, 1);
+}
+
+static void put(jitBuf* j, const char* bytes, int len) {
+    memcpy(j->code + j->size, bytes, len);
+    j->size += len;
+}
+
+static void word(jitBuf* j, int value) {
+    memcpy(j->code + j->size, &value, 4);
+    j->size += 4;
+}
+
+static void byte(jitBuf* j, int value) { j->code[j->size++] = value; }
+
+static void patch(jitBuf* j, int at, int target) {
+    int rel = target - (at + 4);
+    memcpy(j->code + at, &rel, 4);
+}
+
+static void toError(jitBuf* j, int error) {
+    word(j, 0);
+    patch(j, j->size - 4, j->errorAt[error]);
+}
+
+static void toInst(jitBuf* j, int inst) {
+    j->jumps = (jitFixup*)grow(j->jumps, &j->jumpCap, j->jumpCnt + 1,
+                               sizeof(jitFixup));
+    j->jumps[j->jumpCnt++] = (jitFixup){j->size, {.inst = inst}};
+    word(j, 0);
+}
+
+static void toFunc(jitBuf* j, runFunc* f) {
+    j->calls = (jitFixup*)grow(j->calls, &j->callCap, j->callCnt + 1,
+                               sizeof(jitFixup));
+    j->calls[j->callCnt++] = (jitFixup){j->size, {.func = f}};
+    word(j, 0);
+    if (f->jitEntry != 0) return;
+    f->jitEntry = -1;  // queued
+    j->queue = (runFunc**)grow(j->queue, &j->queueCap, j->queueCnt + 1,
+                               sizeof(runFunc*));
+    j->queue[j->queueCnt++] = f;
+}
+
+// copy a template, TS, TI & TC patch in what follows it: a slot, an
+// immediate or a jitCtx field's disp8 from r14
+#define T(bytes) put(j, bytes, sizeof(bytes) - 1)
+#define TS(bytes, slot) (T(bytes), word(j, (slot)*4))
+#define TI(bytes, imm) (T(bytes), word(j, imm))
+#define TC(bytes, field) (T(bytes), byte(j, offsetof(jitCtx, field)))
+#define COUNT "\x49\xff\xc7"    // inc r15
+#define LOAD_EAX "\x8b\x83"     // mov eax, [rbx + slot]
+#define LOAD_ECX "\x8b\x8b"     // mov ecx, [rbx + slot]
+#define STORE_EAX "\x89\x83"    // mov [rbx + slot], eax
+#define STORE_IMM "\xc7\x83"    // mov dword [rbx + slot], imm
+#define CALL_CTX "\x4c\x89\xf7\x48\x83\xec\x08\x41\xff\x56"
+                                // mov rdi, r14; sub rsp, 8; call [r14 + ..]
+#define CALL_CTX_END "\x48\x83\xc4\x08"  // add rsp, 8
+
+// the byte address in eax or ecx is in mem & word aligned
+static void checkEax(jitBuf* j) {
+    T("\xa8\x03\x0f\x85");  // test al, 3; jnz
+    toError(j, ERR_MEM);
+    TI("\x3d", MEM_WORDS * 4);  // cmp eax, imm
+    T("\x0f\x83");              // jae
+    toError(j, ERR_MEM);
+}
+
+static void checkEcx(jitBuf* j) {
+    T("\xf6\xc1\x03\x0f\x85");  // test cl, 3; jnz
+    toError(j, ERR_MEM);
+    TI("\x81\xf9", MEM_WORDS * 4);  // cmp ecx, imm
+    T("\x0f\x83");                  // jae
+    toError(j, ERR_MEM);
+}
+
+static int unfused(int op) {
+    // the second half of a fused op is still in place after it
+    if (op >= RUN_EQ_J && op < RUN_GOTO) return op - (RUN_EQ_J - RUN_EQ);
+    if (op == RUN_MUL_ADD || op == RUN_MUL_ADDR) return RUN_MUL;
+    if (op == RUN_MULI_ADD || op == RUN_MULI_ADDR) return RUN_MULI;
+    return op;
+}
+
+static void compileCond(jitBuf* j, int op, runInst* inst) {
+    // jcc rel32 for EQ to GT
+    static const char jcc[RELOPS][3] = {"\x0f\x84", "\x0f\x85", "\x0f\x8e",
+                                        "\x0f\x8c", "\x0f\x8d", "\x0f\x8f"};
+    // counted whether taken or not
+    TS(COUNT LOAD_EAX, inst->a);
+    if (op >= RUN_EQI)
+        TI("\x3d", inst->b);  // cmp eax, imm
+    else
+        TS("\x3b\x83", inst->b);  // cmp eax, [rbx + slot]
+    put(j, jcc[(op - RUN_EQ) % RELOPS], 2);
+    toInst(j, inst->target);
+}
+
+static void compileInst(jitBuf* j, runFunc* f, runInst* inst) {
+    int op = unfused(inst->op);
+    if (op >= RUN_EQ && op < RUN_EQ_J) {
+        compileCond(j, op, inst);
+        return;
+    }
+    // codes are counted once done, a failing one is not
+    switch (op) {
+        case RUN_NOP:
+            break;
+        case RUN_AS:
+            TS(LOAD_EAX, inst->b);
+            TS(STORE_EAX, inst->a);
+            break;
+        case RUN_ASI:
+            TS(STORE_IMM, inst->a);
+            word(j, inst->b);
+            break;
+        case RUN_ADD:
+        case RUN_SUB:
+        case RUN_MUL:
+            TS(LOAD_EAX, inst->b);
+            if (op == RUN_ADD)
+                TS("\x03\x83", inst->c);  // add eax, [rbx + slot]
+            else if (op == RUN_SUB)
+                TS("\x2b\x83", inst->c);  // sub eax, [rbx + slot]
+            else
+                TS("\x0f\xaf\x83", inst->c);  // imul eax, [rbx + slot]
+            TS(STORE_EAX, inst->a);
+            break;
+        case RUN_ADDI:
+        case RUN_MULI:
+            TS(LOAD_EAX, inst->b);
+            if (op == RUN_ADDI)
+                TI("\x05", inst->c);  // add eax, imm
+            else
+                TI("\x69\xc0", inst->c);  // imul eax, eax, imm
+            TS(STORE_EAX, inst->a);
+            break;
+        case RUN_DIV:
+            TS(LOAD_ECX, inst->c);
+            T("\x85\xc9\x0f\x84");  // test ecx, ecx; jz
+            toError(j, ERR_DIV);
+            TS(LOAD_EAX, inst->b);
+            // x / -1 is -x, wrapping for INT_MIN where idiv would trap
+            T("\x83\xf9\xff\x75\x04"  // cmp ecx, -1; jne idiv
+              "\xf7\xd8\xeb\x03"      // neg eax; jmp done
+              "\x99\xf7\xf9");        // idiv: cdq; idiv ecx
+            TS(STORE_EAX, inst->a);
+            break;
+        case RUN_DIVI:
+            TS(LOAD_EAX, inst->b);
+            TI("\xb9", inst->c);  // mov ecx, imm
+            T("\x99\xf7\xf9");    // cdq; idiv ecx
+            TS(STORE_EAX, inst->a);
+            break;
+        case RUN_ADDR:
+            // the byte address of a slot is rbx - r12 + slot * 4
+            T("\x48\x89\xd8\x4c\x29\xe0");  // mov rax, rbx; sub rax, r12
+            TS("\x05", inst->b);            // add eax, imm
+            TS("\x03\x83", inst->c);        // add eax, [rbx + slot]
+            TS(STORE_EAX, inst->a);
+            break;
+        case RUN_LOAD:
+            TS(LOAD_EAX, inst->b);
+            checkEax(j);
+            T("\x41\x8b\x04\x04");  // mov eax, [r12 + rax]
+            TS(STORE_EAX, inst->a);
+            break;
+        case RUN_STORE:
+            TS(LOAD_EAX, inst->a);
+            checkEax(j);
+            TS(LOAD_ECX, inst->b);
+            T("\x41\x89\x0c\x04");  // mov [r12 + rax], ecx
+            break;
+        case RUN_STOREI:
+            TS(LOAD_EAX, inst->a);
+            checkEax(j);
+            TI("\x41\xc7\x04\x04", inst->b);  // mov dword [r12 + rax], imm
+            break;
+        case RUN_COPY:
+            TS(LOAD_EAX, inst->a);
+            checkEax(j);
+            TS(LOAD_ECX, inst->b);
+            checkEcx(j);
+            T("\x41\x8b\x0c\x0c");  // mov ecx, [r12 + rcx]
+            T("\x41\x89\x0c\x04");  // mov [r12 + rax], ecx
+            break;
+        case RUN_GOTO:
+            T(COUNT "\xe9");  // jmp
+            toInst(j, inst->target);
+            return;
+        case RUN_ARG:
+            TS(LOAD_EAX, inst->a);
+            TC("\x49\x3b\x6e", argsEnd);  // cmp rbp, [r14 + argsEnd]
+            T("\x0f\x83");                // jae
+            toError(j, ERR_ARGS);
+            T("\x89\x45\x00\x48\x83\xc5\x04");  // mov [rbp], eax; add rbp, 4
+            break;
+        case RUN_PARAM:
+            TC("\x49\x3b\x6e", args);  // cmp rbp, [r14 + args]
+            T("\x0f\x86");             // jbe
+            toError(j, ERR_PARAM);
+            T("\x48\x83\xed\x04\x8b\x45\x00");  // sub rbp, 4; mov eax, [rbp]
+            TS(STORE_EAX, inst->a);
+            break;
+        case RUN_CALL:
+            if (inst->callee->code == NULL) {
+                T("\xe9");
+                toError(j, ERR_UNDEFINED);
+                return;
+            }
+            // the callee's frame is right above the caller's
+            TS(COUNT "\x53\x48\x81\xc3", f->frameSize);  // push rbx;
+            T("\xe8");                                   // add rbx, imm; call
+            toFunc(j, inst->callee);
+            T("\x5b");  // pop rbx
+            TS(STORE_EAX, inst->a);
+            return;
+        case RUN_RETURN:
+            TS(LOAD_EAX, inst->a);
+            T(COUNT "\xc3");  // ret
+            return;
+        case RUN_READ:
+            TS("\x48\x8d\xb3", inst->a);  // lea rsi, [rbx + slot]
+            TC(CALL_CTX, read);
+            T(CALL_CTX_END "\x85\xc0\x0f\x84");  // test eax, eax; jz
+            toError(j, ERR_READ);
+            break;
+        case RUN_WRITE:
+            TS("\x8b\xb3", inst->a);  // mov esi, [rbx + slot]
+            TC(CALL_CTX, write);
+            T(CALL_CTX_END);
+            break;
+        case RUN_END:
+            T("\xe9");
+            toError(j, ERR_END);
+            return;
+        default:
+            assert(0);
+    }
+    T(COUNT);
+}
+
+static void compileFunc(jitBuf* j, runFunc* f) {
+    f->jitEntry = j->size;
+    // the frame fits in mem & the native stack has room for a call
+    reserve(j, 64 + f->constCnt * 10);
+    TS("\x48\x8d\x83", f->frameSize);  // lea rax, [rbx + size]
+    T("\x4c\x39\xe8\x0f\x87");         // cmp rax, r13; ja
+    toError(j, ERR_STACK);
+    TC("\x49\x3b\x66", stackLimit);  // cmp rsp, [r14 + stackLimit]
+    T("\x0f\x82");                   // jb
+    toError(j, ERR_STACK);
+    for (int i = 0; i < f->constCnt; i++) {
+        TS(STORE_IMM, f->constBase + i);
+        word(j, f->consts[i]);
+    }
+
+    int cnt = 0;
+    while (f->code[cnt].op != RUN_END) cnt++;
+    j->instAt = (int*)grow(j->instAt, &j->instCap, cnt + 1, sizeof(int));
+    j->jumpCnt = 0;
+    for (int i = 0; i <= cnt; i++) {
+        reserve(j, 128);
+        j->instAt[i] = j->size;
+        compileInst(j, f, &f->code[i]);
+    }
+    for (int i = 0; i < j->jumpCnt; i++)
+        patch(j, j->jumps[i].at, j->instAt[j->jumps[i].inst]);
+}
+
+static void compileEntry(jitBuf* j, runFunc* mainFunc) {
+    // int entry(jitCtx*), switches to the native stack & calls main
+    reserve(j, 256);
+    T("\x53\x55\x41\x54\x41\x55\x41\x56\x41\x57");  // push rbx .. r15
+    T("\x49\x89\xfe");                              // mov r14, rdi
+    TC("\x49\x89\x66", savedSp);                    // mov [..], rsp
+    TC("\x49\x8b\x66", stackTop);                   // mov rsp, [..]
+    TC("\x49\x8b\x5e", mem);                        // mov rbx, [..]
+    TC("\x4d\x8b\x66", mem);                        // mov r12, [..]
+    TC("\x4d\x8b\x6e", memEnd);                     // mov r13, [..]
+    TC("\x49\x8b\x6e", args);                       // mov rbp, [..]
+    // irsim starts on FUNCTION main, a CALL jumps past it
+    TI("\x41\xbf", 1);  // mov r15d, 1
+    T("\xe8");          // call
+    toFunc(j, mainFunc);
+    T("\x31\xc0");  // xor eax, eax
+    int exit = j->size;
+    TC("\x4d\x89\x7e", count);    // mov [..], r15
+    TC("\x49\x8b\x66", savedSp);  // mov rsp, [..]
+    T("\x41\x5f\x41\x5e\x41\x5d\x41\x5c\x5d\x5b\xc3");  // pop r15 .. rbx
+    for (int e = 1; e < ERR_CNT; e++) {
+        j->errorAt[e] = j->size;
+        TC("\x41\xc7\x46", error);  // mov dword [..], e
+        word(j, e);
+        TI("\xb8", 1);  // mov eax, 1
+        TI("\xe9", 0);  // jmp exit
+        patch(j, j->size - 4, exit);
+    }
+}
+
+static int jitRead(jitCtx* ctx, int* dst) {
+    return fscanf(ctx->in, "%d", dst) == 1;
+}
+
+static void jitWrite(jitCtx* ctx, int value) {
+    fprintf(ctx->out, "%d\n", value);
+}
+
+bool jitSupported() { return true; }
+
+int runJit(FILE* in, FILE* out, long long* steps) {
+    runFunc* mainFunc = getRunFunc("main");
+    *steps = 0;
+    if (mainFunc->code == NULL) {
+        fprintf(stderr, "Runtime error: no main function.\n");
+        freeRunFuncs();
+        return 1;
+    }
+
+    jitBuf j;
+    memset(&j, 0, sizeof(j));
+    compileEntry(&j, mainFunc);
+    for (int i = 0; i < j.queueCnt; i++) compileFunc(&j, j.queue[i]);
+    for (int i = 0; i < j.callCnt; i++)
+        patch(&j, j.calls[i].at, j.calls[i].func->jitEntry);
+
+    // written once, then only executable
+    int status = 1;
+    void* code = mmap(NULL, j.size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* stack = mmap(NULL, JIT_STACK, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    jitCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.mem = (int*)calloc(MEM_WORDS, sizeof(int));
+    ctx.args = (int*)malloc(sizeof(int) * MEM_WORDS);
+    if (code == MAP_FAILED || stack == MAP_FAILED || ctx.mem == NULL ||
+        ctx.args == NULL) {
+        fprintf(stderr, "Cannot allocate memory for the JIT.\n");
+    } else {
+        memcpy(code, j.code, j.size);
+        mprotect(code, j.size, PROT_READ | PROT_EXEC);
+        ctx.stackTop = (char*)stack + JIT_STACK;
+        ctx.stackLimit = (char*)stack + JIT_STACK_SPARE;
+        ctx.memEnd = ctx.mem + MEM_WORDS;
+        ctx.argsEnd = ctx.args + MEM_WORDS;
+        ctx.read = jitRead;
+        ctx.write = jitWrite;
+        ctx.in = in;
+        ctx.out = out;
+        status = ((int (*)(jitCtx*))code)(&ctx);
+        if (ctx.error)
+            fprintf(stderr, "Runtime error: %s.\n", errorMsg[ctx.error]);
+        *steps = ctx.count;
+    }
+    fflush(out);
+
+    if (code != MAP_FAILED) munmap(code, j.size);
+    if (stack != MAP_FAILED) munmap(stack, JIT_STACK);
+    free(ctx.mem);
+    free(ctx.args);
+    free(j.code);
+    free(j.instAt);
+    free(j.jumps);
+    free(j.calls);
+    free(j.queue);
+    freeRunFuncs();
+    return status;
+}
+
+#else
+
+bool jitSupported() { return false; }
+
+int runJit(FILE* in, FILE* out, long long* steps) {
+    return runInterp(in, out, steps);
+}
+
+#endif
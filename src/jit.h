@@ -0,0 +1,17 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include <stdio.h>
+
+#include "interp.h"
+
+// --jit: the functions lowered for --run-ir are compiled to x86-64 by
+// copying a machine code template per op & patching in its slots,
+// immediates & jump targets
+
+// whether this build can compile, x86-64 Linux only
+bool jitSupported();
+// run main the way runInterp does, with the same READ/WRITE & count
+int runJit(FILE* in, FILE* out, long long* steps);
+
+#endif
@@ -0,0 +1,452 @@
+#include "layout.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define TAIL_DUP_MAX 4    // most codes of a block copied for one GOTO
+#define LOOP_WEIGHT 8     // a loop body runs this many times per entry
+#define MAX_LOOP_DEPTH 6  // deeper loops weigh the same
+
+static int labelOf(block* b) {
+    return b->first->ic_type == LABEL ? b->first->label_id : 0;
+}
+
+static int swapRelOp(int op_type) {
+    // a op b  <=>  b swapped-op a
+    switch (op_type) {
+        case LT:
+            return GT;
+        case GT:
+            return LT;
+        case LE:
+            return GE;
+        case GE:
+            return LE;
+        default:
+            return op_type;
+    }
+}
+
+static bool impliesRelOp(int op1, int op2) {
+    // a op1 b holds, so does a op2 b
+    if (op1 == op2) return true;
+    switch (op1) {
+        case EQ:
+            return op2 == LE || op2 == GE;
+        case LT:
+            return op2 == LE || op2 == NE;
+        case GT:
+            return op2 == GE || op2 == NE;
+        default:
+            return false;
+    }
+}
+
+static int threadLabel(interCode* jump, int label, int limit) {
+    // jump is known to go to label, follow blocks holding nothing but
+    // a GOTO, or an IF on the same operands whose outcome is known
+    for (int step = 0; step < limit; step++) {
+        block* target = label2Block[label];
+        if (target == NULL || target->first == target->end) break;
+        interCode* code = target->first->next;
+        if (code != target->end) break;
+        if (code->ic_type == GOTO) {
+            label = code->label_id;
+            continue;
+        }
+        if (code->ic_type != COND || jump->ic_type != COND) break;
+
+        int op_type = code->cond.op_type;
+        if (sameOpr(code->cond.opr1, jump->cond.opr2) &&
+            sameOpr(code->cond.opr2, jump->cond.opr1))
+            op_type = swapRelOp(op_type);
+        else if (!sameOpr(code->cond.opr1, jump->cond.opr1) ||
+                 !sameOpr(code->cond.opr2, jump->cond.opr2))
+            break;
+
+        if (impliesRelOp(jump->cond.op_type, op_type)) {
+            label = code->cond.label_id;
+        } else if (impliesRelOp(jump->cond.op_type, reverseRelOp(op_type)) &&
+                   target->flowSeqNext && labelOf(target->flowSeqNext)) {
+            label = labelOf(target->flowSeqNext);
+        } else {
+            break;
+        }
+    }
+    return label;
+}
+
+static bool canDuplicate(block* b, block* target) {
+    if (target == NULL || target == b || labelOf(target) == 0) return false;
+    int count = 0;
+    for (interCode* code = target->first->next;; code = code->next) {
+        if (code == target->first) return false;  // a lone label
+        switch (code->ic_type) {
+            case ASSIGN:
+            case WRITE:
+            case COND:
+            case GOTO:
+            case RETURN_IC:
+                break;
+            default:
+                return false;
+        }
+        if (++count > TAIL_DUP_MAX) return false;
+        if (code == target->end) break;
+    }
+    if (target->end->ic_type == GOTO || target->end->ic_type == RETURN_IC)
+        return true;
+    // falls through at its end, the copy needs a GOTO there
+    return target->flowSeqNext != NULL && labelOf(target->flowSeqNext) != 0;
+}
+
+static void duplicateTail(block* b, block* target) {
+    // GOTO L            code
+    // ...        ==>    IF ... GOTO M
+    // LABEL L :         GOTO N
+    // code
+    // IF ... GOTO M
+    // LABEL N :
+    interCode* jump = b->end;
+    interCode* where = jump;
+    for (interCode* code = target->first->next;; code = code->next) {
+        interCode* copy = copyCode(code);
+        insertCodeAfter(where, copy);
+        where = copy;
+        if (code == target->end) break;
+    }
+    if (target->end->ic_type != GOTO && target->end->ic_type != RETURN_IC) {
+        interCode* fall = newGotoCode(labelOf(target->flowSeqNext));
+        insertCodeAfter(where, fall);
+        where = fall;
+    }
+    removeCode(jump);
+    b->end = where;
+}
+
+void threadJumps(block* entry) {
+    int count = 0;
+    for (block* b = entry; b; b = b->next) count++;
+
+    for (block* b = entry; b; b = b->next) {
+        interCode* jump = b->end;
+        int* label;
+        if (jump->ic_type == GOTO)
+            label = &(jump->label_id);
+        else if (jump->ic_type == COND)
+            label = &(jump->cond.label_id);
+        else
+            continue;
+
+        int to = threadLabel(jump, *label, count);
+        if (to != *label) {
+            *label = to;
+            touchCode(jump);
+        }
+        if (jump->ic_type == GOTO && canDuplicate(b, label2Block[to]))
+            duplicateTail(b, label2Block[to]);
+    }
+}
+
+void hoistDecs(interCode* head) {
+    // FUNCTION, PARAMs & DECs up front stay where they are
+    interCode* top = head;
+    while (top->next != head &&
+           (top->next->ic_type == PARAM || top->next->ic_type == DEC))
+        top = top->next;
+
+    interCode* iter = top->next;
+    while (iter != head) {
+        interCode* next = iter->next;
+        if (iter->ic_type == DEC) {
+            moveCodesAfter(top, iter, iter);
+            top = iter;
+        }
+        iter = next;
+    }
+}
+
+// flow graph of the blocks numbered by position, see layoutBlocks
+typedef struct _flowEdge {
+    int from, to;
+    long long weight;
+    bool seq;  // falls through in the current layout
+} flowEdge;
+
+static int compareEdge(const void* a, const void* b) {
+    const flowEdge* e1 = (const flowEdge*)a;
+    const flowEdge* e2 = (const flowEdge*)b;
+    if (e1->weight != e2->weight) return e1->weight > e2->weight ? -1 : 1;
+    // keep the current layout on ties
+    if (e1->seq != e2->seq) return e1->seq ? -1 : 1;
+    return e1->from - e2->from;
+}
+
+static void getLoopDepth(int n, int (*succ)[2], int* depth) {
+    // DFS finds back edges, each one closes the natural loop of the
+    // block it goes back to
+    int* state = (int*)calloc(n, sizeof(int));  // 1: on stack, 2: done
+    int* stack = (int*)malloc(sizeof(int) * n);
+    int* slot = (int*)malloc(sizeof(int) * n);
+    bool (*back)[2] = (bool(*)[2])calloc(n, sizeof(bool[2]));
+    int top = 0;
+    stack[top] = 0;
+    slot[top++] = 0;
+    state[0] = 1;
+    while (top > 0) {
+        int b = stack[top - 1];
+        if (slot[top - 1] == 2) {
+            state[b] = 2;
+            top--;
+            continue;
+        }
+        int k = slot[top - 1]++;
+        int s = succ[b][k];
+        if (s < 0) continue;
+        if (state[s] == 1) {
+            back[b][k] = true;
+        } else if (state[s] == 0) {
+            state[s] = 1;
+            stack[top] = s;
+            slot[top++] = 0;
+        }
+    }
+
+    // predecessors in CSR form
+    int* start = (int*)calloc(n + 1, sizeof(int));
+    for (int b = 0; b < n; b++)
+        for (int k = 0; k < 2; k++)
+            if (succ[b][k] >= 0) start[succ[b][k] + 1]++;
+    for (int b = 0; b < n; b++) start[b + 1] += start[b];
+    int* preds = (int*)malloc(sizeof(int) * (start[n] + 1));
+    int* fill = (int*)malloc(sizeof(int) * n);
+    for (int b = 0; b < n; b++) fill[b] = start[b];
+    for (int b = 0; b < n; b++)
+        for (int k = 0; k < 2; k++)
+            if (succ[b][k] >= 0) preds[fill[succ[b][k]]++] = b;
+
+    int* inLoop = (int*)malloc(sizeof(int) * n);
+    for (int b = 0; b < n; b++) {
+        depth[b] = 0;
+        inLoop[b] = -1;
+    }
+    for (int h = 0; h < n; h++) {
+        bool isHeader = false;
+        inLoop[h] = h;
+        top = 0;
+        for (int i = start[h]; i < start[h + 1]; i++) {
+            int p = preds[i];
+            if (!(succ[p][0] == h && back[p][0]) &&
+                !(succ[p][1] == h && back[p][1]))
+                continue;
+            isHeader = true;
+            if (inLoop[p] == h) continue;
+            inLoop[p] = h;
+            depth[p]++;
+            stack[top++] = p;
+        }
+        if (!isHeader) continue;
+        depth[h]++;
+        // walk back from the latches until the header
+        while (top > 0) {
+            int b = stack[--top];
+            for (int i = start[b]; i < start[b + 1]; i++) {
+                int p = preds[i];
+                if (inLoop[p] == h || state[p] != 2) continue;
+                inLoop[p] = h;
+                depth[p]++;
+                stack[top++] = p;
+            }
+        }
+    }
+
+    free(inLoop);
+    free(fill);
+    free(preds);
+    free(start);
+    free(back);
+    free(slot);
+    free(stack);
+    free(state);
+}
+
+static long long getEdgeWeight(int* depth, int from, int to) {
+    // an edge runs as often as the outer one of its two ends
+    int d = depth[from] < depth[to] ? depth[from] : depth[to];
+    if (d > MAX_LOOP_DEPTH) d = MAX_LOOP_DEPTH;
+    long long weight = 1;
+    while (d-- > 0) weight *= LOOP_WEIGHT;
+    return weight;
+}
+
+static long long getEdgeCount(long long* freq, int* predCnt,
+                              int (*succ)[2], int from, int to) {
+    // the profile counts blocks, an edge is the only way into its target
+    // or out of its source, or leaves as often as the other edge does not
+    if (predCnt[to] == 1) return freq[to];
+    int other = succ[from][0] == to ? succ[from][1] : succ[from][0];
+    if (other < 0 || other == to) return freq[from];
+    if (predCnt[other] == 1)
+        return freq[from] > freq[other] ? freq[from] - freq[other] : 0;
+    return freq[from] < freq[to] ? freq[from] : freq[to];
+}
+
+static int findChain(int* chain, int b) {
+    while (chain[b] != b) {
+        chain[b] = chain[chain[b]];
+        b = chain[b];
+    }
+    return b;
+}
+
+static void layoutOrder(block** blocks, int n, int (*succ)[2], int* order) {
+    int* depth = (int*)malloc(sizeof(int) * n);
+    getLoopDepth(n, succ, depth);
+    // block counts of the profile, if every block has one
+    long long* freq = (long long*)malloc(sizeof(long long) * n);
+    int* predCnt = (int*)calloc(n, sizeof(int));
+    for (int b = 0; b < n && freq; b++) {
+        freq[b] = blocks[b]->first->freq;
+        if (freq[b] < 0) {
+            free(freq);
+            freq = NULL;
+        }
+    }
+    for (int b = 0; b < n; b++)
+        for (int k = 0; k < 2; k++)
+            if (succ[b][k] >= 0 && (k == 0 || succ[b][1] != succ[b][0]))
+                predCnt[succ[b][k]]++;
+
+    // chains of blocks that fall through to each other,
+    // chain is a union-find telling which chain a block is in
+    int* chainNext = (int*)malloc(sizeof(int) * n);
+    int* chainPrev = (int*)malloc(sizeof(int) * n);
+    int* chain = (int*)malloc(sizeof(int) * n);
+    for (int b = 0; b < n; b++) {
+        chainNext[b] = -1;
+        chainPrev[b] = -1;
+        chain[b] = b;
+    }
+    flowEdge* edges = (flowEdge*)malloc(sizeof(flowEdge) * (2 * n + 1));
+    int edgeCnt = 0;
+    for (int b = 0; b < n; b++) {
+        int seq = succ[b][0], jump = succ[b][1];
+        if (seq >= 0 && labelOf(blocks[seq]) == 0) {
+            // nothing can jump to it, it has to stay behind b
+            chainNext[b] = seq;
+            chainPrev[seq] = b;
+            chain[findChain(chain, seq)] = findChain(chain, b);
+            continue;
+        }
+        if (seq >= 0)
+            edges[edgeCnt++] = (flowEdge){
+                b, seq,
+                freq ? getEdgeCount(freq, predCnt, succ, b, seq)
+                     : getEdgeWeight(depth, b, seq),
+                true};
+        // IF jumps the other way once its target follows, which needs
+        // the label of the block it falls to now
+        if (jump > 0 && jump != b &&
+            (seq < 0 || labelOf(blocks[seq]) != 0))
+            edges[edgeCnt++] = (flowEdge){
+                b, jump,
+                freq ? getEdgeCount(freq, predCnt, succ, b, jump)
+                     : getEdgeWeight(depth, b, jump),
+                false};
+    }
+
+    qsort(edges, edgeCnt, sizeof(flowEdge), compareEdge);
+    for (int i = 0; i < edgeCnt; i++) {
+        int from = edges[i].from, to = edges[i].to;
+        if (to == 0 || chainNext[from] >= 0 || chainPrev[to] >= 0) continue;
+        if (findChain(chain, from) == findChain(chain, to)) continue;
+        chainNext[from] = to;
+        chainPrev[to] = from;
+        chain[findChain(chain, to)] = findChain(chain, from);
+    }
+
+    // the entry's chain first, the others where their heads were,
+    // behind them the chains that never ran in the profile
+    int k = 0;
+    for (int cold = 0; cold < 2; cold++)
+        for (int h = 0; h < n; h++) {
+            if (chainPrev[h] >= 0) continue;
+            if ((h > 0 && freq && freq[h] == 0) != cold) continue;
+            for (int b = h; b >= 0; b = chainNext[b]) order[k++] = b;
+        }
+    assert(k == n);
+
+    free(edges);
+    free(chain);
+    free(chainPrev);
+    free(chainNext);
+    free(predCnt);
+    free(freq);
+    free(depth);
+}
+
+void layoutBlocks(block* entry) {
+    int n = 0;
+    for (block* b = entry; b; b = b->next) b->id = n++;
+    block** blocks = (block**)malloc(sizeof(block*) * n);
+    // [0]: falls through to, [1]: jumps to, -1 if none
+    int(*succ)[2] = (int(*)[2])malloc(sizeof(int[2]) * n);
+    bool movable = true;
+    for (block* b = entry; b; b = b->next) {
+        blocks[b->id] = b;
+        succ[b->id][0] = b->flowSeqNext ? b->flowSeqNext->id : -1;
+        succ[b->id][1] = -1;
+        if (b->end->ic_type == GOTO || b->end->ic_type == COND) {
+            block* target = label2Block[b->gotoId];
+            if (target != NULL) succ[b->id][1] = target->id;
+            movable = movable && target != NULL;
+        }
+        // falls off the end of the function, has to stay last
+        if (b->end->ic_type != GOTO && b->end->ic_type != RETURN_IC &&
+            b->flowSeqNext == NULL)
+            movable = false;
+    }
+    if (!movable) {
+        free(succ);
+        free(blocks);
+        return;
+    }
+
+    int* order = (int*)malloc(sizeof(int) * n);
+    layoutOrder(blocks, n, succ, order);
+    bool same = true;
+    for (int i = 0; i < n; i++) same = same && order[i] == i;
+    if (!same) {
+        // move the blocks into place one after another, then fix up
+        // the jumps at their ends
+        interCode* tail = blocks[order[0]]->end;
+        for (int i = 1; i < n; i++) {
+            block* b = blocks[order[i]];
+            moveCodesAfter(tail, b->first, b->end);
+            tail = b->end;
+        }
+        for (int i = 0; i < n; i++) {
+            block* b = blocks[order[i]];
+            int next = i + 1 < n ? order[i + 1] : -1;
+            int seq = succ[b->id][0], jump = succ[b->id][1];
+            interCode* end = b->end;
+            if (end->ic_type == RETURN_IC || seq == next) continue;
+            if (end->ic_type == GOTO) {
+                if (jump == next) removeCode(end);
+                continue;
+            }
+            assert(labelOf(blocks[seq]) != 0);
+            if (end->ic_type == COND && jump == next) {
+                end->cond.op_type = reverseRelOp(end->cond.op_type);
+                end->cond.label_id = labelOf(blocks[seq]);
+                touchCode(end);
+            } else {
+                insertCodeAfter(end, newGotoCode(labelOf(blocks[seq])));
+            }
+        }
+    }
+
+    free(order);
+    free(succ);
+    free(blocks);
+}
@@ -0,0 +1,21 @@
+#ifndef __LAYOUT_H__
+#define __LAYOUT_H__
+
+#include "block.h"
+#include "intercode.h"
+
+// Both only reuse labels that are already there: labels are numbered
+// across functions and these run on the thread pool
+
+// retarget jumps to the end of GOTO & known IF chains, and copy small
+// blocks in place of the GOTOs to them
+void threadJumps(block* entry);
+// array declarations of inner scopes & inlined calls to the top, so
+// blocks can be moved without moving them behind their uses
+void hoistDecs(interCode* head);
+// reorder blocks so the more frequent successor falls through,
+// the profile or else loop depth gives how frequent a flow edge is,
+// blocks that never ran in the profile go last
+void layoutBlocks(block* entry);
+
+#endif
@@ -1,20 +1,121 @@
 #include "assemble.h"
 #include "header.h"
+#include "interp.h"
 #include "ir.h"
+#include "jit.h"
+#include "optimize.h"
+#include "profile.h"
+#include "remarks.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "timing.h"
 
 int main(int argc, char** argv) {
-    if (argc <= 2) return 1;
+    const char* input = NULL;
+    const char* output = NULL;
+    int threads = 0;  // 0: one worker per online processor
+    const char* remarkPath = NULL;
+    const char* profilePath = NULL;
+    bool emitIR = false;
+    bool runIR = false;
+    bool jit = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-j", 2) == 0) {
+            // -j<N> / -j <N>: worker threads for optimize & codegen
+            if (argv[i][2] != 0)
+                threads = atoi(argv[i] + 2);
+            else if (i + 1 < argc)
+                threads = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "-O", 2) == 0) {
+            // -O0 / -O1 / -O2, -O alone means -O2
+            OptLevel = argv[i][2] != 0 ? atoi(argv[i] + 2) : 2;
+        } else if (strcmp(argv[i], "--ir") == 0) {
+            // write the optimized intercodes instead of assembly
+            emitIR = true;
+        } else if (strcmp(argv[i], "--time-report") == 0) {
+            // time of each phase & pass & peak memory, JSON to stderr
+            TimeReport = true;
+        } else if (strcmp(argv[i], "--remarks") == 0 && i + 1 < argc) {
+            // --remarks <file>: why passes did or did not transform code
+            remarkPath = argv[++i];
+        } else if (strcmp(argv[i], "-fprofile-generate") == 0) {
+            // count how often each block runs, needs --ir & irsim
+            ProfileGenerate = true;
+        } else if (strcmp(argv[i], "-fprofile-use") == 0 && i + 1 < argc) {
+            // -fprofile-use <file>: counts from a -fprofile-generate run
+            profilePath = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            // counts of what the passes did, JSON to stderr
+            Stats = true;
+        } else if (strcmp(argv[i], "--run-ir") == 0) {
+            // run the optimized intercodes instead of writing assembly
+            runIR = true;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            // --run-ir with the intercodes compiled to machine code
+            runIR = jit = true;
+        } else if (input == NULL) {
+            input = argv[i];
+        } else if (output == NULL) {
+            output = argv[i];
+        }
+    }
+    if (input == NULL || (output == NULL && !runIR)) return 1;
+    if (ProfileGenerate && !emitIR) {
+        fprintf(stderr,
+                "-fprofile-generate needs --ir, run the output with "
+                "irsim_cli.py --profile <file>.\n");
+        return 1;
+    }
 
     // initialize input file pointer
-    FILE* fin = fopen(argv[1], "r");
+    FILE* fin = fopen(input, "r");
     if (!fin) {
-        perror(argv[1]);
+        perror(input);
         return 1;
     }
 
+    // initialize output file pointer
+    FILE* fout = NULL;
+    if (!runIR) {
+        fout = fopen(output, "w");
+        if (!fout) {
+            perror(output);
+            return 1;
+        }
+    }
+
+    if (remarkPath) {
+        RemarkFile = fopen(remarkPath, "w");
+        if (!RemarkFile) {
+            perror(remarkPath);
+            return 1;
+        }
+    }
+
+    if (profilePath && !loadProfile(profilePath)) {
+        perror(profilePath);
+        return 1;
+    }
+
+    // each function is translated, optimized & emitted as soon as
+    // it is parsed, instead of after the whole tree is built
+    initThreadPool(threads);
+    if (runIR) {
+        beginRunStream(interpFunctions);
+    } else if (emitIR) {
+        beginStream(fout, interCodeOutput);  // Lab-3
+    } else {
+        assembleHeader(fout);
+        beginStream(fout, assembleFunctions);  // Lab-4
+    }
+    extDefHandler = streamExtDef;
+
     // construct syntax tree
     yyrestart(fin);
-    if (yyparse() == 0 && !yyperr) {
+    phaseBegin(PH_PARSE);
+    int parsed = yyparse();
+    phaseEnd(PH_PARSE);
+    if (parsed == 0 && !yyperr) {
         // output syntax tree
         // printTree(root, 0);  // Lab-1
 
@@ -25,20 +126,23 @@ int main(int argc, char** argv) {
         fprintf(stderr, "%s.\n", errmsgB[SYN_ERR]);
     }
 
-    interCode** codes = interCodeGenerate();
-
-    // initialize output file pointer
-    FILE* fout = fopen(argv[2], "w");
-    if (!fout) {
-        perror(argv[2]);
-        return 1;
+    bool ok = endStream();
+    freeThreadPool();
+    if (TimeReport) phaseReport(stderr);
+    if (Stats) statsReport(stderr);
+    if (RemarkFile) fclose(RemarkFile);
+    if (runIR) {
+        if (!ok) return 1;
+        long long steps = 0;
+        if (jit && !jitSupported())
+            fprintf(stderr, "--jit needs x86-64 Linux, interpreting.\n");
+        int status = jit ? runJit(stdin, stdout, &steps)
+                         : runInterp(stdin, stdout, &steps);
+        fprintf(stderr, "Total instructions = %lld\n", steps);
+        return status;
     }
-
-    // generate intermediate code
-    // interCodeOutput(fout, codes);  // Lab-3
-
-    // generate assembly code
-    assembleGenerate(fout, codes);  // Lab-4
-
-    return 0;
-}
\ No newline at end of file
+    if (ok && !emitIR) assembleFooter(fout);
+    fclose(fout);
+    if (!ok) remove(output);
+    return ok ? 0 : 1;
+}
@@ -47,6 +47,16 @@ int put(root_t *root, const char *key, void *val) {
     return 1;
 }
 
+int erase(root_t *root, const char *key, void (*delval)(void *)) {
+    map_t *data = get(root, key);
+    if (data == NULL) return 0;
+    rb_erase(&data->node, root);
+    if (delval != NULL) delval(data->val);
+    free(data->key);
+    free(data);
+    return 1;
+}
+
 map_t *map_first(root_t *tree) {
     rb_node_t *node = rb_first(tree);
     return (rb_entry(node, map_t, node));
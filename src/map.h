@@ -36,6 +36,7 @@ typedef struct rb_node rb_node_t;
 
 map_t *get(root_t *root, const char *str);
 int put(root_t *root, const char *key, void *val);
+int erase(root_t *root, const char *key, void (*delval)(void *));
 map_t *map_first(root_t *tree);
 map_t *map_next(rb_node_t *node);
 void freeMap(root_t *tree, void (*delval)(void *));
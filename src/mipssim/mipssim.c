@@ -0,0 +1,634 @@
+// mipssim: runs the MIPS32 subset the parser's assembly is written in
+//
+//   mipssim/mipssim [--profile] file.s < input
+//
+// The program's output goes to stdout the way SPIM prints it, the
+// counts of executed instructions, loads, stores & branches to stderr.
+// A pseudo instruction counts as one. --profile adds the instructions
+// run per function & per source line, after the "# line N" comments
+// the parser writes.
+
+#define _DEFAULT_SOURCE
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXT_BASE 0x00400000
+#define DATA_BASE 0x10010000
+#define STACK_TOP 0x80000000u
+#define STACK_WORDS (1 << 24)  // 64MB below STACK_TOP
+#define ZERO_SINK 32           // writes to $zero go here
+
+enum sim_ops {
+    OP_ADD,
+    OP_ADDI,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MFLO,
+    OP_LI,  // la as well, the address is known once parsed
+    OP_MOVE,
+    OP_LW,
+    OP_SW,
+    OP_J,
+    OP_JAL,
+    OP_JR,
+    OP_BEQ,
+    OP_BNE,
+    OP_BGT,
+    OP_BGE,
+    OP_BLT,
+    OP_BLE,
+    OP_SYSCALL,
+    OP_EXIT,  // where $ra points when main starts
+    OP_CNT
+};
+
+// the operand forms an op is written in
+enum sim_forms {
+    F_RRR,     // rd, rs, rt
+    F_RRI,     // rt, rs, imm
+    F_RR,      // rs, rt
+    F_R,       // rd
+    F_RI,      // rd, imm
+    F_RL,      // rd, data label
+    F_MEM,     // rt, imm(rs)
+    F_L,       // text label
+    F_RRL,     // rs, rt, text label
+    F_NONE
+};
+
+static const struct {
+    const char* name;
+    int op;
+    int form;
+} Mnemonics[] = {
+    {"add", OP_ADD, F_RRR},   {"addi", OP_ADDI, F_RRI},
+    {"sub", OP_SUB, F_RRR},   {"mul", OP_MUL, F_RRR},
+    {"div", OP_DIV, F_RR},    {"mflo", OP_MFLO, F_R},
+    {"li", OP_LI, F_RI},      {"la", OP_LI, F_RL},
+    {"move", OP_MOVE, F_RR},  {"lw", OP_LW, F_MEM},
+    {"sw", OP_SW, F_MEM},     {"j", OP_J, F_L},
+    {"jal", OP_JAL, F_L},     {"jr", OP_JR, F_R},
+    {"beq", OP_BEQ, F_RRL},   {"bne", OP_BNE, F_RRL},
+    {"bgt", OP_BGT, F_RRL},   {"bge", OP_BGE, F_RRL},
+    {"blt", OP_BLT, F_RRL},   {"ble", OP_BLE, F_RRL},
+    {"syscall", OP_SYSCALL, F_NONE}};
+
+static const char* const RegNames[32] = {
+    "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3", "t0", "t1", "t2",
+    "t3",   "t4", "t5", "t6", "t7", "s0", "s1", "s2", "s3", "s4", "s5",
+    "s6",   "s7", "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"};
+
+// an instruction decoded once, rd is the register written
+typedef struct _simInst {
+    const void* handler;  // see run
+    int op;
+    int rd, rs, rt;
+    int imm;  // immediate, offset or instruction index of a label
+    int line;
+    int srcLine;       // of the last "# line N", 0 if none
+    int func;          // label starting the function, index into Labels
+    long long count;   // times run
+} simInst;
+
+typedef struct _label {
+    char* name;
+    bool text;
+    int value;  // instruction index or data address
+} label;
+
+static simInst* Code = NULL;
+static int CodeCnt = 0;
+static label* Labels = NULL;
+static int LabelCnt = 0, LabelCap = 0;
+static char* Data = NULL;
+static int DataSize = 0, DataCap = 0;
+static int Line = 0;  // being parsed
+static int SrcLine = 0;
+static int Func = -1;
+
+static void fail(const char* msg, const char* what) {
+    fprintf(stderr, "mipssim: line %d: %s '%s'\n", Line, msg, what);
+    exit(1);
+}
+
+static void* grow(void* array, int* cap, int need, size_t size) {
+    if (need <= *cap) return array;
+    int cap2 = *cap > 0 ? *cap : 64;
+    while (cap2 < need) cap2 *= 2;
+    *cap = cap2;
+    return realloc(array, size * cap2);
+}
+
+static label* findLabel(const char* name) {
+    for (int i = 0; i < LabelCnt; i++)
+        if (strcmp(Labels[i].name, name) == 0) return &Labels[i];
+    return NULL;
+}
+
+static void addLabel(const char* name, bool text) {
+    if (findLabel(name)) fail("duplicate label", name);
+    Labels = (label*)grow(Labels, &LabelCap, LabelCnt + 1, sizeof(label));
+    Labels[LabelCnt].name = strdup(name);
+    Labels[LabelCnt].text = text;
+    Labels[LabelCnt].value = text ? CodeCnt : DATA_BASE + DataSize;
+    LabelCnt++;
+}
+
+static void addData(char c) {
+    Data = (char*)grow(Data, &DataCap, DataSize + 1, 1);
+    Data[DataSize++] = c;
+}
+
+static char* skipSpace(char* s) {
+    while (isspace((unsigned char)*s)) s++;
+    return s;
+}
+
+static int parseReg(char* s) {
+    s = skipSpace(s);
+    if (*s != '$') fail("expected a register", s);
+    s++;
+    if (isdigit((unsigned char)*s)) {
+        int n = atoi(s);
+        if (n >= 0 && n < 32) return n;
+    }
+    for (int i = 0; i < 32; i++)
+        if (strcmp(s, RegNames[i]) == 0) return i;
+    if (strcmp(s, "s8") == 0) return 30;
+    fail("unknown register", s);
+    return 0;
+}
+
+static int parseImm(char* s) {
+    char* end;
+    long v = strtol(skipSpace(s), &end, 0);
+    if (*skipSpace(end) != 0 || v < INT_MIN || v > UINT_MAX)
+        fail("bad immediate", s);
+    return (int)v;
+}
+
+// split "a, b, c" in place, returns the count
+static int splitArgs(char* s, char** args) {
+    int cnt = 0;
+    s = skipSpace(s);
+    if (*s == 0) return 0;
+    while (cnt < 3) {
+        args[cnt++] = s;
+        char* comma = strchr(s, ',');
+        if (comma == NULL) break;
+        *comma = 0;
+        s = comma + 1;
+    }
+    for (int i = 0; i < cnt; i++) {
+        char* end = args[i] + strlen(args[i]);
+        while (end > args[i] && isspace((unsigned char)end[-1])) *--end = 0;
+        args[i] = skipSpace(args[i]);
+    }
+    return cnt;
+}
+
+static void parseString(char* s) {
+    // .asciiz "..."
+    s = skipSpace(s);
+    if (*s++ != '"') fail("expected a string", s);
+    for (; *s != '"'; s++) {
+        if (*s == 0) fail("unterminated string", "");
+        if (*s != '\\') {
+            addData(*s);
+            continue;
+        }
+        s++;
+        addData(*s == 'n' ? '\n' : *s == 't' ? '\t' : *s == '0' ? 0 : *s);
+    }
+    addData(0);
+}
+
+static void parseInst(char* s, bool decode) {
+    char* name = s;
+    while (*s && !isspace((unsigned char)*s)) s++;
+    if (*s) *s++ = 0;
+    int m = 0;
+    int cnt = sizeof(Mnemonics) / sizeof(Mnemonics[0]);
+    while (m < cnt && strcmp(Mnemonics[m].name, name) != 0) m++;
+    if (m == cnt) fail("unknown instruction", name);
+    if (!decode) {
+        CodeCnt++;
+        return;
+    }
+
+    char* args[3];
+    int argc = splitArgs(s, args);
+    static const int argcOf[] = {[F_RRR] = 3, [F_RRI] = 3, [F_RR] = 2,
+                                 [F_R] = 1,   [F_RI] = 2,  [F_RL] = 2,
+                                 [F_MEM] = 2, [F_L] = 1,   [F_RRL] = 3,
+                                 [F_NONE] = 0};
+    int form = Mnemonics[m].form;
+    if (argc != argcOf[form]) fail("wrong operands for", name);
+
+    simInst* inst = &Code[CodeCnt++];
+    memset(inst, 0, sizeof(simInst));
+    inst->op = Mnemonics[m].op;
+    inst->line = Line;
+    inst->srcLine = SrcLine;
+    inst->func = Func;
+    label* l;
+    switch (form) {
+        case F_RRR:
+            inst->rd = parseReg(args[0]);
+            inst->rs = parseReg(args[1]);
+            inst->rt = parseReg(args[2]);
+            break;
+        case F_RRI:
+            inst->rd = parseReg(args[0]);
+            inst->rs = parseReg(args[1]);
+            inst->imm = parseImm(args[2]);
+            break;
+        case F_RR:
+            // move rd, rs & div rs, rt
+            if (inst->op == OP_MOVE) {
+                inst->rd = parseReg(args[0]);
+                inst->rs = parseReg(args[1]);
+            } else {
+                inst->rs = parseReg(args[0]);
+                inst->rt = parseReg(args[1]);
+            }
+            break;
+        case F_R:
+            if (inst->op == OP_JR)
+                inst->rs = parseReg(args[0]);
+            else
+                inst->rd = parseReg(args[0]);
+            break;
+        case F_RI:
+            inst->rd = parseReg(args[0]);
+            inst->imm = parseImm(args[1]);
+            break;
+        case F_RL:
+            inst->rd = parseReg(args[0]);
+            l = findLabel(args[1]);
+            if (l == NULL || l->text) fail("unknown data label", args[1]);
+            inst->imm = l->value;
+            break;
+        case F_MEM: {
+            // rt, imm(rs)
+            inst->rd = inst->rt = parseReg(args[0]);
+            char* open = strchr(args[1], '(');
+            char* close = strchr(args[1], ')');
+            if (open == NULL || close == NULL) fail("bad address", args[1]);
+            *open = *close = 0;
+            inst->imm = *skipSpace(args[1]) ? parseImm(args[1]) : 0;
+            inst->rs = parseReg(open + 1);
+            break;
+        }
+        case F_L:
+        case F_RRL:
+            if (form == F_RRL) {
+                inst->rs = parseReg(args[0]);
+                inst->rt = parseReg(args[1]);
+            }
+            l = findLabel(args[argc - 1]);
+            if (l == NULL || !l->text)
+                fail("unknown text label", args[argc - 1]);
+            inst->imm = l->value;
+            break;
+    }
+    if (inst->op == OP_JAL) inst->rd = 31;
+    // the only ops writing rd
+    bool writes = inst->op <= OP_MOVE || inst->op == OP_LW ||
+                  inst->op == OP_JAL;
+    if (inst->op == OP_DIV) writes = false;
+    if (!writes) inst->rd = ZERO_SINK;
+    if (inst->rd == 0) inst->rd = ZERO_SINK;
+}
+
+static void parse(FILE* f, bool decode) {
+    // the first pass collects the labels, the second decodes
+    char buffer[1024];
+    bool text = false;
+    Line = 0;
+    SrcLine = 0;
+    Func = -1;
+    CodeCnt = 0;
+    DataSize = decode ? DataSize : 0;
+    while (fgets(buffer, sizeof(buffer), f)) {
+        Line++;
+        int n;
+        if (sscanf(buffer, " # line %d", &n) == 1) SrcLine = n;
+        // comments start at a # outside of strings
+        bool quoted = false;
+        for (char* c = buffer; *c; c++) {
+            if (*c == '"' && (c == buffer || c[-1] != '\\')) quoted = !quoted;
+            if (*c == '#' && !quoted) {
+                *c = 0;
+                break;
+            }
+        }
+        char* s = skipSpace(buffer);
+        char* colon = strchr(s, ':');
+        char* quote = strchr(s, '"');
+        if (colon && (quote == NULL || colon < quote)) {
+            *colon = 0;
+            if (!decode) addLabel(s, text);
+            // labelN are jump targets, the others start functions
+            int n;
+            if (decode && text && sscanf(s, "label%d", &n) != 1) {
+                Func = (int)(findLabel(s) - Labels);
+                SrcLine = 0;
+            }
+            s = skipSpace(colon + 1);
+        }
+        char* end = s + strlen(s);
+        while (end > s && isspace((unsigned char)end[-1])) *--end = 0;
+        if (*s == 0) continue;
+        if (strcmp(s, ".text") == 0) {
+            text = true;
+        } else if (strcmp(s, ".data") == 0) {
+            text = false;
+        } else if (strncmp(s, ".asciiz", 7) == 0) {
+            if (!decode) parseString(s + 7);
+        } else if (strncmp(s, ".globl", 6) == 0) {
+        } else if (*s == '.') {
+            fail("unknown directive", s);
+        } else if (!text) {
+            fail("instruction outside .text", s);
+        } else {
+            parseInst(s, decode);
+        }
+    }
+}
+
+typedef struct _simStats {
+    long long insts, loads, stores, branches, taken;
+} simStats;
+
+static int run(simStats* stats) {
+    static const void* const handlers[OP_CNT] = {
+        [OP_ADD] = &&add,         [OP_ADDI] = &&addi, [OP_SUB] = &&sub,
+        [OP_MUL] = &&mul,         [OP_DIV] = &&div,   [OP_MFLO] = &&mflo,
+        [OP_LI] = &&li,           [OP_MOVE] = &&move, [OP_LW] = &&lw,
+        [OP_SW] = &&sw,           [OP_J] = &&j,       [OP_JAL] = &&jal,
+        [OP_JR] = &&jr,           [OP_BEQ] = &&beq,   [OP_BNE] = &&bne,
+        [OP_BGT] = &&bgt,         [OP_BGE] = &&bge,   [OP_BLT] = &&blt,
+        [OP_BLE] = &&ble,         [OP_SYSCALL] = &&syscall,
+        [OP_EXIT] = &&exit};
+    for (int i = 0; i <= CodeCnt; i++) Code[i].handler = handlers[Code[i].op];
+
+    label* entry = findLabel("main");
+    if (entry == NULL || !entry->text) {
+        fprintf(stderr, "mipssim: no main\n");
+        return 1;
+    }
+    int* stack = (int*)calloc(STACK_WORDS, sizeof(int));
+    int r[ZERO_SINK + 1] = {0};
+    int lo = 0;
+    long long insts = 0, loads = 0, stores = 0, branches = 0, taken = 0;
+    unsigned addr;
+    int* word;
+    const char* error = NULL;
+    r[29] = (int)(STACK_TOP - 4);
+    r[31] = TEXT_BASE + CodeCnt * 4;  // OP_EXIT
+    simInst* pc = &Code[entry->value];
+
+#define NEXT()                \
+    do {                      \
+        insts++;              \
+        pc->count++;          \
+        goto*(++pc)->handler; \
+    } while (0)
+#define JUMP(index)        \
+    do {                   \
+        insts++;           \
+        pc->count++;       \
+        pc = &Code[index]; \
+        goto*pc->handler;  \
+    } while (0)
+#define BRANCH(cond)                 \
+    do {                             \
+        branches++;                  \
+        if (cond) {                  \
+            taken++;                 \
+            JUMP(pc->imm);           \
+        }                            \
+        NEXT();                      \
+    } while (0)
+#define FAIL(msg)    \
+    do {             \
+        error = msg; \
+        goto done;   \
+    } while (0)
+// the word at rs + imm, in the stack or the data segment
+#define WORD()                                                         \
+    do {                                                               \
+        addr = (unsigned)r[pc->rs] + (unsigned)pc->imm;                \
+        if (addr & 3) FAIL("unaligned address");                       \
+        if (addr < STACK_TOP && addr >= STACK_TOP - STACK_WORDS * 4u)  \
+            word = &stack[(addr - (STACK_TOP - STACK_WORDS * 4u)) / 4]; \
+        else if (addr >= DATA_BASE && addr + 4 <= DATA_BASE + (unsigned)DataSize) \
+            word = (int*)(Data + (addr - DATA_BASE));                  \
+        else                                                           \
+            FAIL("bad address");                                       \
+    } while (0)
+// add & sub trap on signed overflow
+#define OVERFLOW(sum, x, y) (((sum) ^ (x)) & ((sum) ^ (y)) & INT_MIN)
+
+    long long sum;
+    goto*pc->handler;
+add:
+    sum = (long long)r[pc->rs] + r[pc->rt];
+    if (sum != (int)sum) FAIL("arithmetic overflow");
+    r[pc->rd] = (int)sum;
+    NEXT();
+addi:
+    sum = (long long)r[pc->rs] + pc->imm;
+    if (sum != (int)sum) FAIL("arithmetic overflow");
+    r[pc->rd] = (int)sum;
+    NEXT();
+sub:
+    sum = (long long)r[pc->rs] - r[pc->rt];
+    if (sum != (int)sum) FAIL("arithmetic overflow");
+    r[pc->rd] = (int)sum;
+    NEXT();
+mul:
+    r[pc->rd] = (int)((unsigned)r[pc->rs] * (unsigned)r[pc->rt]);
+    NEXT();
+div:
+    if (r[pc->rt] == 0) FAIL("division by zero");
+    lo = r[pc->rs] == INT_MIN && r[pc->rt] == -1 ? INT_MIN
+                                                 : r[pc->rs] / r[pc->rt];
+    NEXT();
+mflo:
+    r[pc->rd] = lo;
+    NEXT();
+li:
+    r[pc->rd] = pc->imm;
+    NEXT();
+move:
+    r[pc->rd] = r[pc->rs];
+    NEXT();
+lw:
+    WORD();
+    loads++;
+    r[pc->rd] = *word;
+    NEXT();
+sw:
+    WORD();
+    stores++;
+    *word = r[pc->rt];
+    NEXT();
+j:
+    JUMP(pc->imm);
+jal:
+    r[31] = TEXT_BASE + (int)(pc - Code + 1) * 4;
+    JUMP(pc->imm);
+jr:
+    addr = (unsigned)r[pc->rs] - TEXT_BASE;
+    if (addr & 3 || addr / 4 > (unsigned)CodeCnt) FAIL("bad jump target");
+    JUMP(addr / 4);
+beq:
+    BRANCH(r[pc->rs] == r[pc->rt]);
+bne:
+    BRANCH(r[pc->rs] != r[pc->rt]);
+bgt:
+    BRANCH(r[pc->rs] > r[pc->rt]);
+bge:
+    BRANCH(r[pc->rs] >= r[pc->rt]);
+blt:
+    BRANCH(r[pc->rs] < r[pc->rt]);
+ble:
+    BRANCH(r[pc->rs] <= r[pc->rt]);
+syscall:
+    switch (r[2]) {
+        case 1:  // print_int
+            printf("%d", r[4]);
+            break;
+        case 4:  // print_string
+            addr = (unsigned)r[4] - DATA_BASE;
+            if (addr >= (unsigned)DataSize) FAIL("bad string address");
+            fputs(Data + addr, stdout);
+            break;
+        case 5:  // read_int
+            if (scanf("%d", &r[2]) != 1) FAIL("no more input");
+            break;
+        case 10:  // exit
+            goto done;
+        case 11:  // print_char
+            putchar(r[4]);
+            break;
+        default:
+            FAIL("unknown syscall");
+    }
+    NEXT();
+exit:
+    // main returned
+    goto done;
+
+done:
+#undef NEXT
+#undef JUMP
+#undef BRANCH
+#undef FAIL
+#undef WORD
+#undef OVERFLOW
+    fflush(stdout);
+    if (error)
+        fprintf(stderr, "mipssim: line %d: %s\n", pc->line, error);
+    stats->insts = insts;
+    stats->loads = loads;
+    stats->stores = stores;
+    stats->branches = branches;
+    stats->taken = taken;
+    free(stack);
+    return error ? 1 : 0;
+}
+
+typedef struct _profileEntry {
+    int key;
+    long long count;
+} profileEntry;
+
+static int compareEntry(const void* a, const void* b) {
+    long long x = ((profileEntry*)a)->count, y = ((profileEntry*)b)->count;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void printProfile(long long total) {
+    // instructions run per function & per source line, most first
+    int lines = 0;
+    for (int i = 0; i < CodeCnt; i++)
+        if (Code[i].srcLine > lines) lines = Code[i].srcLine;
+    profileEntry* funcs = (profileEntry*)calloc(LabelCnt, sizeof(profileEntry));
+    profileEntry* byLine = (profileEntry*)calloc(lines + 1, sizeof(profileEntry));
+    for (int i = 0; i < LabelCnt; i++) funcs[i].key = i;
+    for (int i = 0; i <= lines; i++) byLine[i].key = i;
+    for (int i = 0; i < CodeCnt; i++) {
+        if (Code[i].func >= 0) funcs[Code[i].func].count += Code[i].count;
+        byLine[Code[i].srcLine].count += Code[i].count;
+    }
+    qsort(funcs, LabelCnt, sizeof(profileEntry), compareEntry);
+    qsort(byLine, lines + 1, sizeof(profileEntry), compareEntry);
+    double scale = total > 0 ? 100.0 / total : 0;
+    fprintf(stderr, "Instructions by function:\n");
+    for (int i = 0; i < LabelCnt && funcs[i].count > 0; i++) {
+        const char* name = Labels[funcs[i].key].name;
+        if (strncmp(name, "F_", 2) == 0) name += 2;
+        fprintf(stderr, "  %-20s %12lld %6.2f%%\n", name, funcs[i].count,
+                funcs[i].count * scale);
+    }
+    fprintf(stderr, "Instructions by source line:\n");
+    for (int i = 0; i <= lines && byLine[i].count > 0; i++) {
+        if (byLine[i].key == 0)
+            fprintf(stderr, "  %-20s", "unknown");
+        else
+            fprintf(stderr, "  line %-15d", byLine[i].key);
+        fprintf(stderr, " %12lld %6.2f%%\n", byLine[i].count,
+                byLine[i].count * scale);
+    }
+    free(funcs);
+    free(byLine);
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    bool profile = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0)
+            profile = true;
+        else if (path == NULL)
+            path = argv[i];
+        else
+            path = "";
+    }
+    if (path == NULL || *path == 0) {
+        fprintf(stderr, "usage: %s [--profile] file.s < input\n", argv[0]);
+        return 1;
+    }
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    parse(f, false);
+    Code = (simInst*)calloc(CodeCnt + 1, sizeof(simInst));
+    rewind(f);
+    parse(f, true);
+    fclose(f);
+    Code[CodeCnt].op = OP_EXIT;
+    Code[CodeCnt].line = Line;
+    Code[CodeCnt].func = -1;
+
+    simStats stats;
+    int status = run(&stats);
+    fprintf(stderr, "Total instructions = %lld\n", stats.insts);
+    fprintf(stderr, "Loads = %lld, Stores = %lld\n", stats.loads,
+            stats.stores);
+    fprintf(stderr, "Branches = %lld, Taken = %lld\n", stats.branches,
+            stats.taken);
+    if (profile) printProfile(stats.insts);
+    return status;
+}
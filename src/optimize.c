@@ -1,332 +1,355 @@
 
 #include "optimize.h"
 
-#define INLINE_MAX_LINE 150
-#define LABEL_MAX_CNT 8
+#include <limits.h>
+
+#include "analysis.h"
+#include "defuse.h"
+#include "inliner.h"
+#include "layout.h"
+#include "remarks.h"
+#include "stats.h"
+#include "timing.h"
+#include "worklist.h"
 
 #define DIV_LIKE_PYTHON 0
 
-bool HAS_PROGRESS;
-root_t InlineTable = RB_ROOT;  // <string, bool>
-
-interCode* getInlineFunction(const char* funcname, root_t* functable) {
-    map_t* find = get(&InlineTable, funcname);
-    map_t* function = get(functable, funcname);
-    if (function == NULL) return NULL;
-
-    interCode* head = function->val;
-    if (find == NULL) {  // check whether this function suits for inline
-        interCode* iter = head;
-        int lineCount = 1;
-        int labelCount = 1;
-        bool* boolean = (bool*)malloc(sizeof(bool));
-        *boolean = true;
-        do {
-            switch (iter->ic_type) {
-                case CALL:
-                    // contains func call
-                    *boolean = false;
-                    break;
-                case LABEL:
-                    labelCount++;
-                    break;
-                default:
-                    break;
-            }
-            if (iter->ic_type != PARAM) lineCount++;
-            if (lineCount * labelCount > INLINE_MAX_LINE * LABEL_MAX_CNT)
-                *boolean = false;
-            iter = iter->next;
-        } while (iter != head);
-        put(&InlineTable, funcname, boolean);
-        if (*boolean) return head;
-        return NULL;
-    }
-    if (*(bool*)(find->val) == true) return head;
-    return NULL;
-}
-
-interCode* findPreviousDef(interCode* from, operand opr) {
-    interCode* iter = from->prev;
-    while (iter) {
-        switch (iter->ic_type) {
-            case FUNCTION:
-            case PARAM:
-            case LABEL:
-            case GOTO:
-            case COND:
-            case RETURN_IC:
-                return NULL;
-            case ARG:
-                if (IS_ADDR(opr) && oprEqual(iter->opr, opr)) return NULL;
-                break;
-            case DEC:
-            case WRITE:
-                break;
-            case CALL:
-                if (oprEqual(opr, iter->call.dst)) return iter;
-                break;
-            case ASSIGN:
-                if (oprEqual(opr, iter->assign.dst)) return iter;
-                break;
-            case READ:
-                if (oprEqual(opr, iter->opr)) return iter;
-                break;
-            default:
-                assert(0);
-        }
-        iter = iter->prev;
-    }
-    return NULL;
-}
-
-interCode* findNextUse(interCode* from, operand opr, operand excp1,
-                       operand excp2) {
-    // opr := excp1 op excp2
-    // xxx := opr
-    // from: from where starts to search
-    // excp1, excp2: if changed, return NULL
-    interCode* iter = from->next;
-    while (iter) {
-        switch (iter->ic_type) {
-            case FUNCTION:
-            case PARAM:
-            case LABEL:
-            case GOTO:
-                return NULL;
-            case DEC:
-                break;
-            case RETURN_IC:
-            case ARG:
-            case WRITE:
-                if (oprEqual(opr, iter->opr)) return iter;
-                break;
-            case COND:
-                if (oprEqual(opr, iter->cond.opr1)) return iter;
-                if (oprEqual(opr, iter->cond.opr2)) return iter;
-                break;
-            case CALL:
-                if (oprEqual(opr, iter->call.dst)) return NULL;
-                if (oprEqual(excp1, iter->call.dst)) return NULL;
-                if (oprEqual(excp2, iter->call.dst)) return NULL;
-                break;
-            case ASSIGN:
-                if (oprEqual(opr, iter->assign.dst)) return NULL;
-                if (oprEqual(excp1, iter->assign.dst)) return NULL;
-                if (oprEqual(excp2, iter->assign.dst)) return NULL;
-                if (oprEqual(opr, iter->assign.src1)) return iter;
-                if (oprEqual(opr, iter->assign.src2)) return iter;
-                break;
-            case READ:
-                if (oprEqual(opr, iter->opr)) return NULL;
-                if (oprEqual(excp1, iter->opr)) return NULL;
-                if (oprEqual(excp2, iter->opr)) return NULL;
-                break;
-            default:
-                assert(0);
-        }
-        iter = iter->next;
-    }
-    return NULL;
-}
+int OptLevel = 2;
 
 bool replacePrevOpr(interCode* current, operand* target) {
-    interCode* src = findPreviousDef(current, *target);
-    if (!src) return false;
-    if (src != current->prev) return false;
     // only check the adjacent previous code
     // to ensure correctness
-
-    if (src->ic_type == ASSIGN && src->assign.op_type == AS) {
+    interCode* src = current->prev;
+    if (src && src->ic_type == ASSIGN && src->assign.op_type == AS &&
+        oprEqual(src->assign.dst, *target)) {
         *target = src->assign.src1;
         return true;
     }
     return false;
 }
 
-interCode* adjacentReplace(interCode* head) {
-    assert(head->ic_type == FUNCTION);
-    interCode* iter = head;
-    interCode* tmp = NULL;
-    do {
-        switch (iter->ic_type) {
-            case RETURN_IC:
-            case WRITE:
-            case ARG:
-                replacePrevOpr(iter, &(iter->opr));
-                break;
-            case COND: {
-                operand prev1 = iter->cond.opr1;
-                operand prev2 = iter->cond.opr2;
-                replacePrevOpr(iter, &(iter->cond.opr2));
-                replacePrevOpr(iter, &(iter->cond.opr1));
-                // not replace var with a temp
-                if (IS_TEMP(iter->cond.opr1) && IS_VAR(prev1))
-                    iter->cond.opr1 = prev1;
-                if (IS_TEMP(iter->cond.opr2) && IS_VAR(prev2))
-                    iter->cond.opr2 = prev2;
-                if (IS_CONST(iter->cond.opr1) && IS_CONST(iter->cond.opr2)) {
-                    // Note: Here MUST use long long in case of overflow
-                    long long val1 = iter->cond.opr1.const_value;
-                    long long val2 = iter->cond.opr2.const_value;
-                    long long diff = val1 - val2;
-                    bool match;
-                    switch (iter->cond.op_type) {
-                        case EQ:
-                            match = diff == 0;
-                            break;
-                        case NE:
-                            match = diff != 0;
-                            break;
-                        case GE:
-                            match = diff >= 0;
-                            break;
-                        case GT:
-                            match = diff > 0;
-                            break;
-                        case LE:
-                            match = diff <= 0;
-                            break;
-                        case LT:
-                            match = diff < 0;
-                            break;
-                        default:
-                            assert(0);
-                    }
-                    if (match) {
-                        iter->ic_type = GOTO;
-                        iter->label_id = iter->cond.label_id;
-                    } else {
-                        iter = removeCodeItr(iter, true);
-                    }
-                }
-                break;
-            }
-            case ASSIGN:
-                switch (iter->assign.op_type) {
-                    case AS:
-                        if (iter->prev->ic_type == ASSIGN &&
-                            iter->prev->assign.op_type == ADDR &&
-                            IS_EOPR(iter->prev->assign.src2) &&
-                            oprEqual(iter->prev->assign.dst,
-                                     iter->assign.src1)) {
-                            iter->assign.op_type = iter->prev->assign.op_type;
-                            iter->assign.src1 = iter->prev->assign.src1;
-                            break;
-                        }
-                        replacePrevOpr(iter, &(iter->assign.src1));
+static void adjacentReplaceCode(interCode* iter) {
+    interCode before = *iter;
+    switch (iter->ic_type) {
+        case RETURN_IC:
+        case WRITE:
+        case ARG:
+            replacePrevOpr(iter, &(iter->opr));
+            break;
+        case COND: {
+            operand prev1 = iter->cond.opr1;
+            operand prev2 = iter->cond.opr2;
+            replacePrevOpr(iter, &(iter->cond.opr2));
+            replacePrevOpr(iter, &(iter->cond.opr1));
+            // not replace var with a temp
+            if (IS_TEMP(iter->cond.opr1) && IS_VAR(prev1))
+                iter->cond.opr1 = prev1;
+            if (IS_TEMP(iter->cond.opr2) && IS_VAR(prev2))
+                iter->cond.opr2 = prev2;
+            if (IS_CONST(iter->cond.opr1) && IS_CONST(iter->cond.opr2)) {
+                // Note: Here MUST use long long in case of overflow
+                long long val1 = iter->cond.opr1.const_value;
+                long long val2 = iter->cond.opr2.const_value;
+                long long diff = val1 - val2;
+                bool match;
+                switch (iter->cond.op_type) {
+                    case EQ:
+                        match = diff == 0;
                         break;
-                    case ADD:
-                    case SUB:
-                    case MUL:
-                    case DIVD:
-                        if (iter->prev->ic_type == ASSIGN &&
-                            iter->prev->assign.op_type == ADDR &&
-                            IS_EOPR(iter->prev->assign.src2) &&
-                            iter->assign.op_type == ADD) {
-                            // t1 := &v
-                            // t2 := t1 + t3  ==> t2 := &v + t3
-                            if (oprEqual(iter->prev->assign.dst,
-                                         iter->assign.src1)) {
-                                iter->assign.op_type = ADDR;
-                                iter->assign.src1 = iter->prev->assign.src1;
-                                break;
-                            } else if (oprEqual(iter->prev->assign.dst,
-                                                iter->assign.src2)) {
-                                iter->assign.op_type = ADDR;
-                                iter->assign.src2 = iter->assign.src1;
-                                iter->assign.src1 = iter->prev->assign.src1;
-                                break;
-                            }
-                        }
-                        replacePrevOpr(iter, &(iter->assign.src1));
-                        replacePrevOpr(iter, &(iter->assign.src2));
-                        if (iter->assign.op_type == SUB &&
-                            oprEqual(iter->assign.src1, iter->assign.src2)) {
-                            iter->assign.op_type = AS;
-                            iter->assign.src1 = zeroOpr;
-                            iter->assign.src2 = nullOpr;
-                            break;
-                        }
-                        if (iter->assign.op_type == DIVD &&
-                            oprEqual(iter->assign.src1, iter->assign.src2)) {
-                            iter->assign.op_type = AS;
-                            iter->assign.src1 = newOperand(CONST, 1);
-                            iter->assign.src2 = nullOpr;
-                            break;
-                        }
-
-                        if (IS_CONST(iter->assign.src1) &&
-                            IS_CONST(iter->assign.src2)) {
-                            int val1 = iter->assign.src1.const_value;
-                            int val2 = iter->assign.src2.const_value;
-                            int res = 0;
-                            if (iter->assign.op_type == ADD)
-                                res = val1 + val2;
-                            else if (iter->assign.op_type == SUB)
-                                res = val1 - val2;
-                            else if (iter->assign.op_type == MUL)
-                                res = val1 * val2;
-                            else {
-                                if (val2 == 0) break;
-                                res = val1 / val2;
-                                if (DIV_LIKE_PYTHON) {
-                                    float tmp_res = (float)val1 / (float)val2;
-                                    if (tmp_res < 0 && val1 % val2 != 0)
-                                        res = (int)tmp_res - 1;
-                                }
-                            }
-                            iter->assign.op_type = AS;
-                            iter->assign.src1 = newOperand(CONST, res);
-                            iter->assign.src2 = nullOpr;
-                        }
+                    case NE:
+                        match = diff != 0;
+                        break;
+                    case GE:
+                        match = diff >= 0;
+                        break;
+                    case GT:
+                        match = diff > 0;
                         break;
+                    case LE:
+                        match = diff <= 0;
+                        break;
+                    case LT:
+                        match = diff < 0;
+                        break;
+                    default:
+                        assert(0);
                 }
-                break;
+                if (match) {
+                    iter->ic_type = GOTO;
+                    iter->label_id = iter->cond.label_id;
+                } else {
+                    removeCode(iter);
+                    return;
+                }
+            }
+            break;
         }
-        if (iter->ic_type == ASSIGN) {
+        case ASSIGN:
             switch (iter->assign.op_type) {
-                case ADD:
-                    if (IS_ZERO(iter->assign.src1)) {
-                        iter->assign.op_type = AS;
-                        iter->assign.src1 = iter->assign.src2;
-                        iter->assign.src2 = nullOpr;
-                    } else if (IS_ZERO(iter->assign.src2)) {
-                        iter->assign.op_type = AS;
-                        iter->assign.src2 = nullOpr;
+                case AS:
+                    if (iter->prev->ic_type == ASSIGN &&
+                        iter->prev->assign.op_type == ADDR &&
+                        IS_EOPR(iter->prev->assign.src2) &&
+                        oprEqual(iter->prev->assign.dst,
+                                 iter->assign.src1)) {
+                        iter->assign.op_type = iter->prev->assign.op_type;
+                        iter->assign.src1 = iter->prev->assign.src1;
+                        break;
                     }
+                    replacePrevOpr(iter, &(iter->assign.src1));
                     break;
+                case ADD:
                 case SUB:
-                    if (IS_ZERO(iter->assign.src2)) {
-                        iter->assign.op_type = AS;
-                        iter->assign.src2 = nullOpr;
-                    }
-                    break;
                 case MUL:
-                    if (IS_ONE(iter->assign.src1)) {
+                case DIVD:
+                    if (iter->prev->ic_type == ASSIGN &&
+                        iter->prev->assign.op_type == ADDR &&
+                        IS_EOPR(iter->prev->assign.src2) &&
+                        iter->assign.op_type == ADD) {
+                        // t1 := &v
+                        // t2 := t1 + t3  ==> t2 := &v + t3
+                        if (oprEqual(iter->prev->assign.dst,
+                                     iter->assign.src1)) {
+                            iter->assign.op_type = ADDR;
+                            iter->assign.src1 = iter->prev->assign.src1;
+                            break;
+                        } else if (oprEqual(iter->prev->assign.dst,
+                                            iter->assign.src2)) {
+                            iter->assign.op_type = ADDR;
+                            iter->assign.src2 = iter->assign.src1;
+                            iter->assign.src1 = iter->prev->assign.src1;
+                            break;
+                        }
+                    }
+                    replacePrevOpr(iter, &(iter->assign.src1));
+                    replacePrevOpr(iter, &(iter->assign.src2));
+                    if (iter->assign.op_type == SUB &&
+                        oprEqual(iter->assign.src1, iter->assign.src2)) {
                         iter->assign.op_type = AS;
-                        iter->assign.src1 = iter->assign.src2;
+                        iter->assign.src1 = zeroOpr;
                         iter->assign.src2 = nullOpr;
-                    } else if (IS_ONE(iter->assign.src2)) {
+                        break;
+                    }
+                    if (iter->assign.op_type == DIVD &&
+                        oprEqual(iter->assign.src1, iter->assign.src2)) {
                         iter->assign.op_type = AS;
+                        iter->assign.src1 = newOperand(CONST, 1);
                         iter->assign.src2 = nullOpr;
+                        break;
                     }
-                    break;
-                case DIVD:
-                    if (IS_ONE(iter->assign.src2)) {
+
+                    if (IS_CONST(iter->assign.src1) &&
+                        IS_CONST(iter->assign.src2)) {
+                        int val1 = iter->assign.src1.const_value;
+                        int val2 = iter->assign.src2.const_value;
+                        int res = 0;
+                        if (iter->assign.op_type == ADD)
+                            res = val1 + val2;
+                        else if (iter->assign.op_type == SUB)
+                            res = val1 - val2;
+                        else if (iter->assign.op_type == MUL)
+                            res = val1 * val2;
+                        else {
+                            if (val2 == 0) break;
+                            res = val1 / val2;
+                            if (DIV_LIKE_PYTHON) {
+                                float tmp_res = (float)val1 / (float)val2;
+                                if (tmp_res < 0 && val1 % val2 != 0)
+                                    res = (int)tmp_res - 1;
+                            }
+                        }
                         iter->assign.op_type = AS;
+                        iter->assign.src1 = newOperand(CONST, res);
                         iter->assign.src2 = nullOpr;
                     }
                     break;
             }
+            break;
+    }
+    if (iter->ic_type == ASSIGN) {
+        switch (iter->assign.op_type) {
+            case ADD:
+                if (IS_ZERO(iter->assign.src1)) {
+                    iter->assign.op_type = AS;
+                    iter->assign.src1 = iter->assign.src2;
+                    iter->assign.src2 = nullOpr;
+                } else if (IS_ZERO(iter->assign.src2)) {
+                    iter->assign.op_type = AS;
+                    iter->assign.src2 = nullOpr;
+                }
+                break;
+            case SUB:
+                if (IS_ZERO(iter->assign.src2)) {
+                    iter->assign.op_type = AS;
+                    iter->assign.src2 = nullOpr;
+                }
+                break;
+            case MUL:
+                if (IS_ONE(iter->assign.src1)) {
+                    iter->assign.op_type = AS;
+                    iter->assign.src1 = iter->assign.src2;
+                    iter->assign.src2 = nullOpr;
+                } else if (IS_ONE(iter->assign.src2)) {
+                    iter->assign.op_type = AS;
+                    iter->assign.src2 = nullOpr;
+                }
+                break;
+            case DIVD:
+                if (IS_ONE(iter->assign.src2)) {
+                    iter->assign.op_type = AS;
+                    iter->assign.src2 = nullOpr;
+                }
+                break;
         }
+    }
+    if (!codeEqual(&before, iter)) touchCode(iter);
+}
+
+void adjacentReplace(interCode* head) {
+    assert(head->ic_type == FUNCTION);
+    // only codes queued since the last run, see worklist.h
+    interCode* code;
+    while ((code = popCode()) != NULL) adjacentReplaceCode(code);
+}
+
+// where the copies of useReplace reach, from the def-use chains
+typedef struct _copyReach {
+    int* killFrom;  // idx -> end of its entries in kills
+    int* kills;     // positions redefining each idx in code order,
+                    // idx 0 for where the straight code ends
+    int codeCnt;
+    interCode** uses;  // of the copy being propagated, in code order
+    int useCap;
+} copyReach;
+
+static int killedIdx(interCode* code) {
+    // what a copy cannot be carried over, -1 if nothing
+    operand dst;
+    switch (code->ic_type) {
+        case FUNCTION:
+        case PARAM:
+        case LABEL:
+        case GOTO:
+            return 0;
+        case ASSIGN:
+            // *x := y as well
+            dst = code->assign.dst;
+            break;
+        case CALL:
+            dst = code->call.dst;
+            break;
+        case READ:
+            dst = code->opr;
+            break;
+        default:
+            return -1;
+    }
+    int idx = getOprIndex(dst);
+    return idx > 0 ? idx : -1;
+}
+
+static void findKills(copyReach* r, interCode* head) {
+    int size = VarCount + TempCount + 1;
+    r->killFrom = (int*)calloc(size + 1, sizeof(int));
+    int pos = 0;
+    interCode* iter = head;
+    do {
+        iter->pos = pos++;
+        int idx = killedIdx(iter);
+        if (idx >= 0) r->killFrom[idx + 1]++;
+        iter = iter->next;
+    } while (iter != head);
+    r->codeCnt = pos;
+    for (int i = 1; i <= size; i++) r->killFrom[i] += r->killFrom[i - 1];
+    r->kills = (int*)malloc(sizeof(int) * (r->killFrom[size] + 1));
+    // each idx fills up to where idx + 1 starts
+    do {
+        int idx = killedIdx(iter);
+        if (idx >= 0) r->kills[r->killFrom[idx]++] = iter->pos;
         iter = iter->next;
     } while (iter != head);
-    return head;
+    r->uses = NULL;
+    r->useCap = 0;
+}
+
+static int killAfter(copyReach* r, int idx, int pos) {
+    // first position after pos redefining idx, INT_MAX if none
+    int lo = idx > 0 ? r->killFrom[idx - 1] : 0, hi = r->killFrom[idx];
+    int end = hi;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (r->kills[mid] <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < end ? r->kills[lo] : INT_MAX;
+}
+
+static int comparePos(const void* a, const void* b) {
+    return (*(interCode**)a)->pos - (*(interCode**)b)->pos;
+}
+
+static bool usesIdx(interCode* code, int idx) {
+    for (int i = 0; i < 3; i++)
+        if (code->uses[i].idx == idx) return true;
+    return false;
+}
+
+static void addCopyUse(copyReach* r, int cnt, interCode* code) {
+    if (cnt == r->useCap) {
+        r->useCap = r->useCap > 0 ? r->useCap * 2 : 16;
+        r->uses =
+            (interCode**)realloc(r->uses, sizeof(interCode*) * r->useCap);
+    }
+    r->uses[cnt] = code;
+}
+
+static int findCopyUses(copyReach* r, interCode* def) {
+    // uses of def's dst up to where dst or a source is redefined
+    operand oprs[3] = {def->assign.dst, def->assign.src1, def->assign.src2};
+    int end = killAfter(r, 0, def->pos);
+    for (int i = 0; i < 3; i++) {
+        int idx = getOprIndex(oprs[i]);
+        if (idx > 0 && killAfter(r, idx, def->pos) < end)
+            end = killAfter(r, idx, def->pos);
+    }
+    if (end > r->codeCnt) end = r->codeCnt;
+    int idx = getOprIndex(def->assign.dst);
+
+    // the chain holds every use in the function, the code in reach
+    // may be shorter, e.g. for a variable assigned over & over
+    int cnt = 0, walked = 0;
+    oprRef* ref = useTable[idx];
+    for (; ref != NULL; ref = ref->next) {
+        if (++walked > end - def->pos) break;
+        interCode* code = ref->code;
+        if (code->pos <= def->pos || code->pos >= end) continue;
+        addCopyUse(r, cnt++, code);
+    }
+    if (ref != NULL) {
+        cnt = 0;
+        interCode* code = def->next;
+        // the function's head at position 0 closes the list
+        for (; code->pos > def->pos && code->pos < end; code = code->next)
+            if (usesIdx(code, idx)) addCopyUse(r, cnt++, code);
+        return cnt;
+    }
+    qsort(r->uses, cnt, sizeof(interCode*), comparePos);
+    // a cond using it twice is chained twice
+    int kept = 0;
+    for (int i = 0; i < cnt; i++)
+        if (kept == 0 || r->uses[kept - 1] != r->uses[i])
+            r->uses[kept++] = r->uses[i];
+    return kept;
 }
 
-interCode* useReplace(interCode* head) {
+void useReplace(interCode* head) {
     assert(head->ic_type == FUNCTION);
+    // copies only reach along straight code, but the chains lead to
+    // their uses without scanning the code in between
+    copyReach reach;
+    findKills(&reach, head);
     interCode* iter = head;
     do {
         // search for code which is an assign code
@@ -339,9 +362,10 @@ interCode* useReplace(interCode* head) {
         }
 
         if (iter->assign.op_type == AS) {
-            interCode* repl =
-                findNextUse(iter, iter->assign.dst, iter->assign.src1, nullOpr);
-            while (repl) {
+            int cnt = findCopyUses(&reach, iter);
+            for (int i = 0; i < cnt; i++) {
+                interCode* repl = reach.uses[i];
+                interCode before = *repl;
                 switch (repl->ic_type) {
                     case RETURN_IC:
                     case ARG:
@@ -363,34 +387,40 @@ interCode* useReplace(interCode* head) {
                     default:
                         assert(0);
                 }
-                if (repl->ic_type != COND && repl->ic_type != RETURN_IC)
-                    // current can be replaced, but not the following
-                    repl = findNextUse(repl, iter->assign.dst,
-                                       iter->assign.src1, nullOpr);
-                else
+                // x := x changes nothing
+                if (!codeEqual(&before, repl)) {
+                    touchCode(repl);
+                    STAT_ADD(ST_COPIES, 1);
+                }
+                // current can be replaced, but not the following
+                if (repl->ic_type == COND || repl->ic_type == RETURN_IC)
                     break;
             }
         } else if (iter->assign.op_type == ADDR && IS_EOPR(iter->assign.src2)) {
             // x := &v
             // ...
             // y := x + w ==> y := &v + w
-            interCode* repl =
-                findNextUse(iter, iter->assign.dst, iter->assign.src1, nullOpr);
-            while (repl) {
+            // y := x     ==> y := &v
+            int cnt = findCopyUses(&reach, iter);
+            for (int i = 0; i < cnt; i++) {
+                interCode* repl = reach.uses[i];
                 if (repl->ic_type == ASSIGN &&
+                    (repl->assign.op_type == ADD ||
+                     repl->assign.op_type == AS) &&
                     oprEqual(repl->assign.src1, iter->assign.dst)) {
                     repl->assign.src1 = iter->assign.src1;
                     repl->assign.op_type = ADDR;
+                    touchCode(repl);
+                    STAT_ADD(ST_COPIES, 1);
                 }
-                repl = findNextUse(repl, iter->assign.dst, iter->assign.src1,
-                                   nullOpr);
             }
         } else if (iter->assign.op_type == ADD || iter->assign.op_type == SUB ||
                    iter->assign.op_type == MUL ||
                    iter->assign.op_type == DIVD) {
-            interCode* repl = findNextUse(iter, iter->assign.dst,
-                                          iter->assign.src1, iter->assign.src2);
-            while (repl) {
+            int cnt = findCopyUses(&reach, iter);
+            for (int i = 0; i < cnt; i++) {
+                interCode* repl = reach.uses[i];
+                interCode before = *repl;
                 if (repl->ic_type == ASSIGN) {
                     if (repl->assign.op_type == AS) {
                         // t1 := a op b
@@ -466,20 +496,15 @@ interCode* useReplace(interCode* head) {
                     }
                 } else
                     break;
-                repl = findNextUse(repl, iter->assign.dst, iter->assign.src1,
-                                   iter->assign.src2);
+                if (!codeEqual(&before, repl)) touchCode(repl);
             }
         }
 
         iter = iter->next;
     } while (iter != head);
-    return head;
-}
-
-void clearList(bool* list, int size) {
-    for (int i = 0; i < size; i++) {
-        list[i] = true;
-    }
+    free(reach.killFrom);
+    free(reach.kills);
+    free(reach.uses);
 }
 
 void setOutActive(bool* active, block* b) {
@@ -528,7 +553,6 @@ void inactiveRemoveInBlock(block* b) {
                     int idx = getOprIndex(dst);
                     if (active[idx] == false) {
                         // dst is an inactive operand
-                        HAS_PROGRESS = true;
                         if (iter == b->first) {
                             b->first = iter->next;
                             removeCode(iter);
@@ -576,32 +600,35 @@ void globalInactiveRemove(block* entry) {
     }
 }
 
-interCode* inactiveRemove(interCode* head) {
+void inactiveRemove(interCode* head) {
     assert(head->ic_type == FUNCTION);
     interCode* iter = head->prev;
     int listSize = VarCount + TempCount + 1;
-    bool* active = (bool*)malloc(sizeof(bool) * listSize);
-    clearList(active, listSize);
+    // deadAt[idx] == region: idx is assigned again later in this
+    // region before any use. Starting a new region at each label or
+    // jump makes everything active again without clearing the list
+    int* deadAt = (int*)malloc(sizeof(int) * listSize);
+    for (int i = 0; i < listSize; i++) deadAt[i] = -1;
+    int region = 0;
     do {
         switch (iter->ic_type) {
             case FUNCTION:
             case PARAM:
-                free(active);
-                return head;
+                free(deadAt);
+                return;
             case LABEL:
             case GOTO:
             case COND:
             case RETURN_IC:
-                clearList(active, listSize);
+                region++;
                 iter = iter->prev;  // Warning Here
                 continue;
             case ASSIGN: {
                 operand dst = getCodeDst(iter);
                 if (!IS_EOPR(dst) && !IS_CONST(dst)) {
                     int idx = getOprIndex(dst);
-                    if (active[idx] == false) {
+                    if (deadAt[idx] == region) {
                         // dst is an inactive operand
-                        HAS_PROGRESS = true;
                         iter = removeCodeItr(iter, false);
                         continue;
                     }
@@ -614,20 +641,19 @@ interCode* inactiveRemove(interCode* head) {
         if (isDefCode(iter)) {
             operand dst = getCodeDst(iter);
             int idx = getOprIndex(dst);
-            active[idx] = false;
+            deadAt[idx] = region;
         }
         operand use[3];
         int cnt = getCodeUse(iter, use);
         for (int i = 0; i < cnt; i++) {
             int idx = getOprIndex(use[i]);
-            active[idx] = true;
+            deadAt[idx] = -1;
         }
 
         iter = iter->prev;
     } while (iter != head);
 
-    free(active);
-    return head;
+    free(deadAt);
 }
 
 void replaceBlockOpr(block* entry) {
@@ -735,7 +761,6 @@ void replaceBlockOpr(block* entry) {
                             if (prev->ic_type == ASSIGN &&
                                 prev->assign.op_type == AS) {
                                 *repl[i] = prev->assign.src1;
-                                HAS_PROGRESS = true;
                             }
                         }
                     } else {
@@ -751,7 +776,6 @@ void replaceBlockOpr(block* entry) {
                                 oprEqual(prev1->assign.src1,
                                          prev2->assign.src1)) {
                                 *repl[i] = prev1->assign.src1;
-                                HAS_PROGRESS = true;
                             }
                         }
                     }
@@ -798,8 +822,8 @@ void mergeCondGoto(interCode* head) {
             if (iter->cond.label_id == iter->next->next->label_id) {
                 iter->cond.op_type = reverseRelOp(iter->cond.op_type);
                 iter->cond.label_id = iter->next->label_id;
+                touchCode(iter);
                 removeCode(iter->next);
-                HAS_PROGRESS = true;
             } else {
                 iter = iter->next->next->next;
             }
@@ -809,105 +833,393 @@ void mergeCondGoto(interCode* head) {
     } while (iter != head);
 }
 
-interCode* removeUselessLabel(interCode* head) {
+// labels are numbered across all functions, each worker only
+// resets the entries of labels defined in its current function
+// label -> label it was merged into or jumps on to, union-find
+static THREAD_LOCAL int* labelAlias = NULL;
+// label -> count of GOTO & IF GOTO to it
+static THREAD_LOCAL int* labelUses = NULL;
+static THREAD_LOCAL int labelCap = 0;
+
+static int findLabel(int label) {
+    while (labelAlias[label] != label) {
+        labelAlias[label] = labelAlias[labelAlias[label]];
+        label = labelAlias[label];
+    }
+    return label;
+}
+
+static int* getJumpLabel(interCode* code) {
+    if (code->ic_type == GOTO) return &(code->label_id);
+    if (code->ic_type == COND) return &(code->cond.label_id);
+    return NULL;
+}
+
+void removeUselessLabel(interCode* head) {
+    if (labelCap < LabelCount + 1) {
+        free(labelAlias);
+        free(labelUses);
+        labelCap = LabelCount + 1;
+        labelAlias = (int*)malloc(sizeof(int) * labelCap);
+        labelUses = (int*)malloc(sizeof(int) * labelCap);
+    }
     interCode* iter = head;
-    bool* used = (bool*)malloc(sizeof(bool) * (LabelCount + 1));
-    for (int i = 0; i < LabelCount + 1; i++) used[i] = false;
     do {
         if (iter->ic_type == LABEL) {
-            if (iter->next->ic_type == LABEL) {
-                // Label A :
-                // Label B :
-                interCode* modifyIter = head;
-                int modifyId = iter->next->label_id;
-                int thisId = iter->label_id;
+            labelAlias[iter->label_id] = iter->label_id;
+            labelUses[iter->label_id] = 0;
+        }
+        iter = iter->next;
+    } while (iter != head);
+
+    do {
+        if (iter->ic_type == LABEL) {
+            // Label A :
+            // Label B :    B is merged into A
+            while (iter->next->ic_type == LABEL) {
+                labelAlias[iter->next->label_id] = findLabel(iter->label_id);
                 removeCode(iter->next);
-                HAS_PROGRESS = true;
-                do {
-                    if (modifyIter->ic_type == GOTO) {
-                        if (modifyIter->label_id == modifyId)
-                            modifyIter->label_id = thisId;
-                    }
-                    if (modifyIter->ic_type == COND) {
-                        if (modifyIter->cond.label_id == modifyId)
-                            modifyIter->cond.label_id = thisId;
-                    }
-                    modifyIter = modifyIter->next;
-                } while (modifyIter != head);
-            } else if (iter->next->ic_type == GOTO) {
-                // Label A :
-                // Goto B
-                interCode* modifyIter = head;
-                int modifyId = iter->next->label_id;
-                int thisId = iter->label_id;
-                do {
-                    if (modifyIter->ic_type == GOTO) {
-                        if (modifyIter->label_id == thisId)
-                            modifyIter->label_id = modifyId;
-                    }
-                    if (modifyIter->ic_type == COND) {
-                        if (modifyIter->cond.label_id == thisId)
-                            modifyIter->cond.label_id = modifyId;
-                    }
-                    modifyIter = modifyIter->next;
-                } while (modifyIter != head);
+            }
+            // Label A :
+            // Goto B       jumps to A go to B instead
+            if (iter->next->ic_type == GOTO) {
+                int from = findLabel(iter->label_id);
+                int to = findLabel(iter->next->label_id);
+                // Label A : Goto A loops forever, keep it
+                if (from != to) labelAlias[from] = to;
             }
         }
         iter = iter->next;
     } while (iter != head);
 
+    // every jump straight to the end of its chain
     do {
-        if (iter->ic_type == COND) {
-            used[iter->cond.label_id] = true;
-        }
-        if (iter->ic_type == GOTO) {
-            used[iter->label_id] = true;
+        int* label = getJumpLabel(iter);
+        if (label != NULL) {
+            int to = findLabel(*label);
+            if (to != *label) {
+                *label = to;
+                touchCode(iter);
+            }
+            labelUses[to]++;
         }
         iter = iter->next;
     } while (iter != head);
 
     do {
-        if (iter->ic_type == LABEL && used[iter->label_id] == false) {
+        if (iter->ic_type == LABEL && labelUses[iter->label_id] == 0) {
             iter = removeCodeItr(iter, true);
-            HAS_PROGRESS = true;
         } else {
             iter = iter->next;
         }
     } while (iter != head);
+}
 
-    free(used);
+void removeUselessOpr(interCode* head) {
+    assert(head->ic_type == FUNCTION);
+    // removing defs drops their uses from the chains as well,
+    // which may leave more variables unused in the same run
+    int idx;
+    while (popUnused(&idx)) {
+        oprRef* def = defTable[idx];
+        while (def != NULL) {
+            oprRef* next = def->next;
+            if (def->code->ic_type != CALL) {
+                removeCode(def->code);
+            }
+            def = next;
+        }
+    }
+}
+
+#define SCALAR_MAX_WORDS 16  // arrays up to this size may become variables
 
-    return head;
+// a local array & the variables its elements become
+typedef struct _scalarArray {
+    int words;
+    bool escapes;  // an address of it is used other than to load or store
+    int firstVar;  // element k becomes firstVar + k
+} scalarArray;
+
+// what the walk knows of an operand
+typedef struct _scalarAddr {
+    int array;    // points to element offset of arrays[array - 1], or 0
+    int offset;
+    int leaks;    // array it held at the end of a block, -1 if several
+    int definedIn;  // last run of straight code that defined it
+    bool exposed;   // used in a run before being defined there
+} scalarAddr;
+
+typedef struct _scalarWalk {
+    scalarArray* arrays;
+    int* arrayOf;  // var_id -> 1 + index into arrays, 0 if none
+    scalarAddr* addrs;
+    int* tracked;  // operands set to an array since the run began
+    int trackedCnt;
+    int run;
+    bool rewrite;
+} scalarWalk;
+
+static scalarAddr* addrOf(scalarWalk* w, operand opr) {
+    if (!IS_VAR(opr) && !IS_TEMP(opr)) return NULL;
+    scalarAddr* a = &w->addrs[getOprIndex(opr)];
+    if (a->array == 0 || (w->rewrite && w->arrays[a->array - 1].escapes))
+        return NULL;
+    return a;
 }
 
-interCode* removeUselessOpr(interCode* head) {
-    for (int i = 1; i < VarCount + TempCount + 1; i++) {
-        int idx = i;
-        if (useTable[idx] == NULL) {
-            // var / temp not used
-            // remove related def codes
-            defNode* iter = defTable[idx];
-            while (iter != NULL) {
-                if (iter->code->ic_type != CALL) {
-                    removeCode(iter->code);
-                    HAS_PROGRESS = true;
-                }
-                defNode* to_free = iter;
-                iter = iter->next;
-                free(to_free);
+static void escape(scalarWalk* w, int array) {
+    if (array > 0) w->arrays[array - 1].escapes = true;
+}
+
+static void useAddr(scalarWalk* w, operand opr, bool allowed) {
+    // an address used other than to load, store or derive another
+    // lets the array escape
+    if (w->rewrite) return;
+    if (IS_VAR(opr)) escape(w, w->arrayOf[opr.var_id]);
+    if (!IS_VAR(opr) && !IS_TEMP(opr)) return;
+    scalarAddr* a = &w->addrs[getOprIndex(opr)];
+    if (a->definedIn != w->run) a->exposed = true;
+    if (a->array != 0 && !allowed) escape(w, a->array);
+}
+
+static void setAddr(scalarWalk* w, operand dst, int array, int offset) {
+    scalarAddr* a = &w->addrs[getOprIndex(dst)];
+    if (array != 0 && (offset < 0 || offset >= w->arrays[array - 1].words)) {
+        escape(w, array);
+        array = 0;
+    }
+    a->array = array;
+    a->offset = offset;
+    a->definedIn = w->run;
+    if (array != 0) w->tracked[w->trackedCnt++] = getOprIndex(dst);
+}
+
+static void leakAddrs(scalarWalk* w) {
+    // addresses held where the code may jump, see scalarReplace
+    if (w->rewrite) return;
+    for (int i = 0; i < w->trackedCnt; i++) {
+        scalarAddr* a = &w->addrs[w->tracked[i]];
+        if (a->array == 0 || a->leaks == a->array) continue;
+        if (a->leaks != 0) {
+            escape(w, a->leaks);
+            escape(w, a->array);
+            a->leaks = -1;
+        } else {
+            a->leaks = a->array;
+        }
+    }
+}
+
+static void endRun(scalarWalk* w) {
+    for (int i = 0; i < w->trackedCnt; i++) w->addrs[w->tracked[i]].array = 0;
+    w->trackedCnt = 0;
+    w->run++;
+}
+
+static operand elemOf(scalarWalk* w, scalarAddr* a) {
+    return newOperand(VARIABLE, w->arrays[a->array - 1].firstVar + a->offset);
+}
+
+static interCode* walkAssign(scalarWalk* w, interCode* code) {
+    // return the code after, the rewrite may remove this one
+    interCode* next = code->next;
+    operand dst = code->assign.dst;
+    operand src1 = code->assign.src1, src2 = code->assign.src2;
+    scalarAddr* from = NULL;  // dst derives from it
+    int array = 0, offset = 0;
+    switch (code->assign.op_type) {
+        case ADDR:
+            // &v + #k is no use of v
+            if (IS_VAR(src1) && w->arrayOf[src1.var_id]) {
+                array = w->arrayOf[src1.var_id];
+                if (IS_CONST(src2) && src2.const_value % 4 == 0)
+                    offset = src2.const_value / 4;
+                else if (!IS_EOPR(src2))
+                    escape(w, array);
+                if (w->rewrite && w->arrays[array - 1].escapes) array = 0;
             }
-            defTable[idx] = NULL;
+            if (!IS_EOPR(src2)) useAddr(w, src2, false);
+            break;
+        case AS:
+            from = addrOf(w, src1);
+            useAddr(w, src1, true);
+            break;
+        case ADD:
+        case SUB:
+            from = addrOf(w, src1);
+            if (from != NULL && IS_CONST(src2) && src2.const_value % 4 == 0) {
+                offset = src2.const_value / 4;
+                if (code->assign.op_type == SUB) offset = -offset;
+                useAddr(w, src1, true);
+            } else {
+                from = NULL;
+                useAddr(w, src1, false);
+                useAddr(w, src2, false);
+            }
+            break;
+        case RSTAR: {
+            // x := *a  ==>  x := e
+            scalarAddr* a = addrOf(w, src1);
+            useAddr(w, src1, true);
+            if (w->rewrite && a != NULL) {
+                code->assign.op_type = AS;
+                code->assign.src1 = elemOf(w, a);
+                touchCode(code);
+            }
+            break;
         }
+        case LSTAR:
+        case LRSTAR: {
+            // *a := x  ==>  e := x, *a := *b  ==>  e := *b, *a := f or e := f
+            bool load = code->assign.op_type == LRSTAR;
+            scalarAddr* to = addrOf(w, dst);
+            scalarAddr* a = load ? addrOf(w, src1) : NULL;
+            useAddr(w, dst, true);
+            useAddr(w, src1, load);
+            if (!w->rewrite || (to == NULL && a == NULL)) return next;
+            if (a != NULL) code->assign.src1 = elemOf(w, a);
+            if (to != NULL) code->assign.dst = elemOf(w, to);
+            if (to == NULL)
+                code->assign.op_type = LSTAR;
+            else
+                code->assign.op_type = load && a == NULL ? RSTAR : AS;
+            touchCode(code);
+            return next;
+        }
+        default:
+            useAddr(w, src1, false);
+            if (!IS_EOPR(src2)) useAddr(w, src2, false);
+            break;
     }
-    return head;
+    if (from != NULL) {
+        array = from->array;
+        offset += from->offset;
+    }
+    setAddr(w, dst, array, offset);
+    // the address itself is not needed any more
+    if (w->rewrite && w->addrs[getOprIndex(dst)].array != 0) removeCode(code);
+    return next;
+}
+
+static void walkAddrs(scalarWalk* w, interCode* head) {
+    interCode* iter = head->next;
+    while (iter != head) {
+        interCode* next = iter->next;
+        switch (iter->ic_type) {
+            case LABEL:
+            case GOTO:
+                leakAddrs(w);
+                endRun(w);
+                break;
+            case DEC:
+                if (w->rewrite && w->arrayOf[iter->dec.var_id] &&
+                    !w->arrays[w->arrayOf[iter->dec.var_id] - 1].escapes)
+                    removeCode(iter);
+                break;
+            case ASSIGN:
+                next = walkAssign(w, iter);
+                break;
+            case COND:
+                useAddr(w, iter->cond.opr1, false);
+                useAddr(w, iter->cond.opr2, false);
+                leakAddrs(w);
+                break;
+            case ARG:
+            case WRITE:
+                useAddr(w, iter->opr, false);
+                break;
+            case RETURN_IC:
+                useAddr(w, iter->opr, false);
+                endRun(w);
+                break;
+            case READ:
+            case PARAM:
+                setAddr(w, iter->opr, 0, 0);
+                break;
+            case CALL:
+                setAddr(w, iter->call.dst, 0, 0);
+                break;
+            default:
+                break;
+        }
+        iter = next;
+    }
+    endRun(w);
+}
+
+void scalarReplace(interCode* head) {
+    // small local arrays only loaded & stored at constant offsets become
+    // a variable per element. Addresses are followed through copies &
+    // constant offsets within a run of straight code. One held at a
+    // jump or label may reach a use in another run, so the array
+    // escapes if the operand holding it is read in a run before that
+    // run defines it
+    int arrayCnt = 0, codeCnt = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        if (iter->ic_type == DEC && iter->dec.size <= SCALAR_MAX_WORDS * 4)
+            arrayCnt++;
+        codeCnt++;
+    }
+    if (arrayCnt == 0) return;
+
+    int size = VarCount + TempCount + 1;
+    scalarWalk w;
+    w.arrays = (scalarArray*)malloc(sizeof(scalarArray) * arrayCnt);
+    w.arrayOf = (int*)calloc(VarCount + 1, sizeof(int));
+    w.addrs = (scalarAddr*)calloc(size, sizeof(scalarAddr));
+    w.tracked = (int*)malloc(sizeof(int) * (codeCnt + 1));
+    w.trackedCnt = 0;
+    w.run = 1;
+    w.rewrite = false;
+    arrayCnt = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next) {
+        if (iter->ic_type != DEC || iter->dec.size > SCALAR_MAX_WORDS * 4)
+            continue;
+        w.arrays[arrayCnt] = (scalarArray){iter->dec.size / 4, false, 0};
+        w.arrayOf[iter->dec.var_id] = ++arrayCnt;
+    }
+
+    walkAddrs(&w, head);
+    for (int i = 1; i < size; i++)
+        if (w.addrs[i].exposed) escape(&w, w.addrs[i].leaks);
+    int firstVar = VarCount + 1;
+    for (int i = 0; i < arrayCnt; i++) {
+        if (w.arrays[i].escapes) continue;
+        w.arrays[i].firstVar = firstVar;
+        firstVar += w.arrays[i].words;
+        remark(RM_PASSED, "scalar-replace", head, 0,
+               "array of %d words replaced by a variable per element",
+               w.arrays[i].words);
+    }
+    if (firstVar > VarCount + 1) {
+        // the chains are indexed by getOprIndex, which the new
+        // variables change
+        endDefUse();
+        w.rewrite = true;
+        walkAddrs(&w, head);
+        VarCount = firstVar - 1;
+    }
+    free(w.arrays);
+    free(w.arrayOf);
+    free(w.addrs);
+    free(w.tracked);
 }
 
 void removeUnreachableBlock(block* entry) {
     dfs(entry, entry->isVisited);
+    // unreachable blocks may jump to each other, drop those edges
+    // first so no removeBlock follows one to a freed block
+    for (block* b = entry; b; b = b->next) {
+        if (b->isVisited == entry->isVisited) continue;
+        if (b->flowSeqNext && b->flowSeqNext->isVisited != entry->isVisited)
+            b->flowSeqNext = NULL;
+        if (b->flowGotoNext && b->flowGotoNext->isVisited != entry->isVisited)
+            b->flowGotoNext = NULL;
+    }
     block* iter = entry;
     while (iter) {
         if (iter->isVisited != entry->isVisited) {  // Not Reached
-            HAS_PROGRESS = true;
             iter = removeBlock(iter);
         } else {
             iter = iter->next;
@@ -915,262 +1227,243 @@ void removeUnreachableBlock(block* entry) {
     }
 }
 
-void replaceInlineFunction(interCode* head, root_t* functable) {
-    interCode* iter = head->next;
-    while (iter != head) {
-        if (iter->ic_type != CALL) {
-            iter = iter->next;
-            continue;
-        }
-        interCode* repl = getInlineFunction(iter->call.func_name, functable);
-        if (repl == NULL) {
-            iter = iter->next;
-            continue;
-        }
+void removeUnreachableBlockPass(interCode* head) {
+    assert(head->ic_type == FUNCTION);
+    removeUnreachableBlock(requireCFG());
+}
 
-        operand dst = iter->call.dst;
-        repl = copyInterCode(repl);
+void globalInactiveRemovePass(interCode* head) {
+    // data flow costs too much with many blocks
+    block* entry = requireCFG();
+    if (!DO_GLOBAL_REMOVE) {
+        int blocks = 0;
+        for (block* b = entry; b != NULL; b = b->next) blocks++;
+        remark(RM_MISSED, "global-inactive", head, 0,
+               "%d blocks >= MAX_BLOCK_CNT %d, dead code only removed "
+               "within blocks",
+               blocks, MAX_BLOCK_CNT);
+        return;
+    }
+    globalInactiveRemove(requireLiveness());
+}
 
-        interCode* next = iter->next;
-        // record where iter should go
-
-        int previous_id = VarCount;
-
-        // replace PARAM vi; ARG ai ==> vi = ai
-        interCode* arg_iter = iter->prev;
-        interCode* param_iter = repl->next;
-        while (param_iter->ic_type == PARAM) {
-            operand param = param_iter->opr;
-            operand new_param = allocVar();
-            param_iter->ic_type = ASSIGN;
-            param_iter->assign.op_type = AS;
-            param_iter->assign.dst = new_param;
-            param_iter->assign.src1 = arg_iter->opr;
-            param_iter->assign.src2 = nullOpr;
-            arg_iter = removeCodeItr(arg_iter, false);
-            param_iter = param_iter->next;
-            interCode* var_iter = param_iter;
-            do {
-                if (var_iter->ic_type == ASSIGN) {
-                    if (oprEqual(param, var_iter->assign.dst)) {
-                        var_iter->assign.dst = new_param;
-                    }
-                    if (oprEqual(param, var_iter->assign.src1)) {
-                        var_iter->assign.src1 = new_param;
-                    }
-                    if (oprEqual(param, var_iter->assign.src2)) {
-                        var_iter->assign.src2 = new_param;
-                    }
-                } else if (var_iter->ic_type == READ ||
-                           var_iter->ic_type == WRITE ||
-                           var_iter->ic_type == RETURN_IC) {
-                    if (oprEqual(param, var_iter->opr)) {
-                        var_iter->opr = new_param;
-                    }
-                } else if (var_iter->ic_type == COND) {
-                    if (oprEqual(param, var_iter->cond.opr1)) {
-                        var_iter->cond.opr1 = new_param;
-                    }
-                    if (oprEqual(param, var_iter->cond.opr2)) {
-                        var_iter->cond.opr2 = new_param;
-                    }
-                }
-                var_iter = var_iter->next;
-            } while (var_iter != repl);
-        }
-        // add label for return
-        int ret_label = allocLabel();
-        // replace RETURN ret; x := CALL ==> x := ret; GOTO return
-        interCode* repl_iter = param_iter;
-        while (repl_iter != repl) {
-            if (repl_iter->ic_type == RETURN_IC) {
-                operand ret = repl_iter->opr;
-                repl_iter->ic_type = ASSIGN;
-                repl_iter->assign.op_type = AS;
-                repl_iter->assign.dst = dst;
-                repl_iter->assign.src1 = ret;
-                repl_iter->assign.src2 = nullOpr;
-                insertCodeAfter(repl_iter, newGotoCode(ret_label));
-            } else if (repl_iter->ic_type == LABEL) {
-                int old_lb = repl_iter->label_id;
-                int new_lb = allocLabel();
-                interCode* lb_iter = repl;
-                do {
-                    if (lb_iter->ic_type == LABEL || lb_iter->ic_type == GOTO) {
-                        if (lb_iter->label_id == old_lb)
-                            lb_iter->label_id = new_lb;
-                    } else if (lb_iter->ic_type == COND) {
-                        if (lb_iter->cond.label_id == old_lb)
-                            lb_iter->cond.label_id = new_lb;
-                    }
-                    lb_iter = lb_iter->next;
-                } while (lb_iter != repl);
-            } else if (repl_iter->ic_type == DEC) {
-                int old_id = repl_iter->dec.var_id;
-                operand old_opr = newOperand(VARIABLE, old_id);
-                operand new_opr = allocVar();
-                int new_id = new_opr.var_id;
-                repl_iter->dec.var_id = new_id;
-
-                interCode* dec_iter = repl_iter;
-                do {
-                    if (dec_iter->ic_type == ASSIGN) {
-                        if (oprEqual(old_opr, dec_iter->assign.dst)) {
-                            dec_iter->assign.dst = new_opr;
-                        }
-                        if (oprEqual(old_opr, dec_iter->assign.src1)) {
-                            dec_iter->assign.src1 = new_opr;
-                        }
-                        if (oprEqual(old_opr, dec_iter->assign.src2)) {
-                            dec_iter->assign.src2 = new_opr;
-                        }
-                    }
-                    dec_iter = dec_iter->next;
-                } while (dec_iter != repl);
-            } else if (repl_iter->ic_type == READ ||
-                       repl_iter->ic_type == ASSIGN) {
-                operand old_opr = getCodeDst(repl_iter);
-                if (old_opr.var_id <= previous_id) {
-                    operand new_opr = allocVar();
-                    interCode* var_iter = repl_iter;
-                    do {
-                        if (var_iter->ic_type == ASSIGN) {
-                            if (oprEqual(old_opr, var_iter->assign.dst)) {
-                                var_iter->assign.dst = new_opr;
-                            }
-                            if (oprEqual(old_opr, var_iter->assign.src1)) {
-                                var_iter->assign.src1 = new_opr;
-                            }
-                            if (oprEqual(old_opr, var_iter->assign.src2)) {
-                                var_iter->assign.src2 = new_opr;
-                            }
-                        } else if (var_iter->ic_type == READ ||
-                                   var_iter->ic_type == WRITE ||
-                                   var_iter->ic_type == RETURN_IC) {
-                            if (oprEqual(old_opr, var_iter->opr)) {
-                                var_iter->opr = new_opr;
-                            }
-                        } else if (var_iter->ic_type == COND) {
-                            if (oprEqual(old_opr, var_iter->cond.opr1)) {
-                                var_iter->cond.opr1 = new_opr;
-                            }
-                            if (oprEqual(old_opr, var_iter->cond.opr2)) {
-                                var_iter->cond.opr2 = new_opr;
-                            }
-                        }
-                        var_iter = var_iter->next;
-                    } while (var_iter != repl);
-                }
-            }
-            repl_iter = repl_iter->next;
-        }
+void threadJumpsPass(interCode* head) {
+    assert(head->ic_type == FUNCTION);
+    threadJumps(requireCFG());
+}
 
-        // Label return :
-        insertCodeAfter(repl->prev, newLabelCode(ret_label));
-        // remove FUNCTION :
-        repl = removeCodeItr(repl, true);
-        // remove CALL
-        iter = removeCodeItr(iter, false);
+void blockLayoutPass(interCode* head) {
+    hoistDecs(head);
+    layoutBlocks(requireCFG());
+}
 
-        interCode* end = repl->prev;
-        insertCodeAfter(iter, repl);
+// a pass reads the analyses in requires, and keeps the ones in
+// preserves up to date when it changes the code
+typedef struct _pass {
+    const char* name;
+    void (*run)(interCode* head);
+    int requires;
+    int preserves;
+} pass;
 
-        HAS_PROGRESS = true;
+enum pass_id {
+    USELESS_GOTO_P,
+    ADJACENT_REPLACE_P,
+    USE_REPLACE_P,
+    INACTIVE_REMOVE_P,
+    USELESS_OPR_P,
+    SCALAR_REPLACE_P,
+    UNREACHABLE_BLOCK_P,
+    GLOBAL_INACTIVE_P,
+    MERGE_COND_GOTO_P,
+    USELESS_LABEL_P,
+    JUMP_THREAD_P,
+    BLOCK_LAYOUT_P,
+    PASS_CNT
+};
 
-        iter = next;
-    }
+static const pass Passes[PASS_CNT] = {
+    [USELESS_GOTO_P] = {"useless-goto", removeUselessGoto, 0, 0},
+    [ADJACENT_REPLACE_P] = {"adjacent-replace", adjacentReplace, 0, 0},
+    [USE_REPLACE_P] = {"use-replace", useReplace, DEFUSE_A, CFG_A},
+    [INACTIVE_REMOVE_P] = {"inactive-remove", inactiveRemove, 0, 0},
+    [USELESS_OPR_P] = {"useless-opr", removeUselessOpr, DEFUSE_A, 0},
+    [SCALAR_REPLACE_P] = {"scalar-replace", scalarReplace, 0, 0},
+    [UNREACHABLE_BLOCK_P] = {"unreachable-block", removeUnreachableBlockPass,
+                             CFG_A, CFG_A},
+    [GLOBAL_INACTIVE_P] = {"global-inactive", globalInactiveRemovePass, CFG_A,
+                           0},
+    [MERGE_COND_GOTO_P] = {"merge-cond-goto", mergeCondGoto, 0, 0},
+    [USELESS_LABEL_P] = {"useless-label", removeUselessLabel, 0, 0},
+    [JUMP_THREAD_P] = {"jump-thread", threadJumpsPass, CFG_A, 0},
+    [BLOCK_LAYOUT_P] = {"block-layout", blockLayoutPass, CFG_A, 0},
+};
+
+// CodeVersion at which each pass last ran without changing anything
+static THREAD_LOCAL int idleAt[PASS_CNT];
+
+// what each pass did for --time-report & --stats, summed over workers
+typedef struct _passRecord {
+    long long runs;     // not skipped as idle
+    long long changes;  // runs that changed the code
+    long long removed;  // codes less after the pass than before
+    long long wall;     // nanoseconds, analyses it required included
+    long long cpu;
+} passRecord;
+
+static passRecord passRecords[PASS_CNT];
+
+static int codeLength(interCode* head) {
+    int len = 0;
+    for (interCode* iter = head->next; iter != head; iter = iter->next) len++;
+    return len;
 }
 
-void simpleOptimize(root_t* funtable) {
-    initDefUse();
+#define RECORD_ADD(field, n) \
+    __atomic_fetch_add(&passRecords[id].field, (n), __ATOMIC_RELAXED)
 
-    for (map_t* node = map_first(funtable); node;
-         node = map_next(&(node->node))) {
-        interCode* code = (interCode*)node->val;
+bool runPass(int id, interCode* head) {
+    // a pass run again on the same code has nothing to do
+    if (idleAt[id] == CodeVersion) return false;
+    const pass* p = &Passes[id];
+    long long wall = TimeReport ? wallNanos() : 0;
+    long long cpu = TimeReport ? threadNanos() : 0;
+    int length = Stats ? codeLength(head) : 0;
+    if (p->requires & CFG_A) requireCFG();
+    if (p->requires & DEFUSE_A) requireDefUse();
+    if (p->requires & LIVENESS_A) requireLiveness();
 
-        // removeUselessLabel(code);
-        // delay this
-        removeUselessGoto(code);
-        adjacentReplace(code);
-        useReplace(code);
-        inactiveRemove(code);
+    int valid = validAnalyses();
+    int version = CodeVersion;
+    p->run(head);
+    if (TimeReport) {
+        RECORD_ADD(wall, wallNanos() - wall);
+        RECORD_ADD(cpu, threadNanos() - cpu);
+    }
+    if (Stats) {
+        RECORD_ADD(runs, 1);
+        RECORD_ADD(changes, CodeVersion != version);
+        RECORD_ADD(removed, length - codeLength(head));
+    }
+    if (CodeVersion == version) {
+        idleAt[id] = version;
+        return false;
+    }
+    keepAnalyses(valid & p->preserves);
+    return true;
+}
 
-        getDefsAndUses(code);
-        removeUselessOpr(code);
+void passesReport(FILE* f, bool times) {
+    fprintf(f, "\"passes\": {");
+    for (int id = 0; id < PASS_CNT; id++) {
+        passRecord* r = &passRecords[id];
+        fprintf(f, "%s\"%s\": {", id > 0 ? ", " : "", Passes[id].name);
+        if (times)
+            fprintf(f, "\"wall\": %.6f, \"cpu\": %.6f}", r->wall * 1e-9,
+                    r->cpu * 1e-9);
+        else
+            fprintf(f, "\"runs\": %lld, \"changes\": %lld, \"removed\": %lld}",
+                    r->runs, r->changes, r->removed);
     }
+    fprintf(f, "}");
 }
 
-void globalOptimize(root_t* funtable) {
-    initBlock();
+// passes run again and again until none of them changes the code
+static const int LocalPasses[] = {USELESS_GOTO_P, ADJACENT_REPLACE_P,
+                                  USE_REPLACE_P, INACTIVE_REMOVE_P,
+                                  USELESS_OPR_P, SCALAR_REPLACE_P};
+// need the flow graph, run once
+static const int GlobalPasses[] = {UNREACHABLE_BLOCK_P, GLOBAL_INACTIVE_P};
+// Remove Label after all things done
+// To simplify Block Relation
+static const int LabelPasses[] = {MERGE_COND_GOTO_P, USELESS_LABEL_P};
+// reshape the flow graph once the labels left are the ones needed
+static const int CfgPasses[] = {JUMP_THREAD_P, BLOCK_LAYOUT_P};
 
-    int recordSize = LabelCount + 5;  // in case LabelCount == 0
-    int recordCnt = 0;
-    block** records = (block**)malloc(sizeof(block*) * recordSize);
+#define LIST_LEN(list) ((int)(sizeof(list) / sizeof((list)[0])))
+#define PASSES(list) list, LIST_LEN(list)
 
-    for (map_t* node = map_first(funtable); node;
-         node = map_next(&(node->node))) {
-        interCode* code = (interCode*)node->val;
+void runPasses(const int* ids, int count, interCode* code) {
+    for (int i = 0; i < count; i++) runPass(ids[i], code);
+}
 
-        block* b = getBlocks(code);
-        block* entry = getFlowGraph(b);
+void runToFixedPoint(const int* ids, int count, interCode* code) {
+    // a pass is skipped while the code is the same as when it last
+    // found nothing to do, stop once all of them are
+    int idle = 0;
+    for (int i = 0; idle < count; i = (i + 1) % count) {
+        if (i == 0) STAT_ADD(ST_ROUNDS, 1);
+        if (runPass(ids[i], code))
+            idle = 0;
+        else
+            idle++;
+    }
+}
 
-        removeUnreachableBlock(entry);
+void beginOptimize(interCode* code) {
+    enterFunction(code);
+    beginAnalyses(code);
+    for (int i = 0; i < PASS_CNT; i++) idleAt[i] = -1;
+    if (code->settled) {
+        // nothing left for the local passes until something changes
+        for (int i = 0; i < LIST_LEN(LocalPasses); i++)
+            idleAt[LocalPasses[i]] = CodeVersion;
+    }
+    beginWorklist(code, !code->settled);
+}
 
-        if (DO_GLOBAL_REMOVE) {
-            while (setBlockUseIn(entry))
-                ;
-            globalInactiveRemove(entry);
-        }
+void endOptimize(interCode* code) {
+    endWorklist();
+    endAnalyses();
+    code->settled = true;
+    for (int i = 0; i < LIST_LEN(LocalPasses); i++)
+        code->settled &= idleAt[LocalPasses[i]] == CodeVersion;
+    leaveFunction(code);
+}
 
-        // while (setOutBlocks(entry, entry->isVisited)) {}
-        // replaceBlockOpr(entry);
+void optimizeBeforeInline(int idx, void* funcs) {
+    interCode* code = ((interCode**)funcs)[idx];
+    beginOptimize(code);
+    runToFixedPoint(PASSES(LocalPasses), code);
+    endOptimize(code);
+}
 
-        if (recordCnt >= recordSize) {
-            recordSize *= 2;
-            block** new_records = (block**)malloc(sizeof(block*) * recordSize);
-            for (int i = 0; i < recordCnt; i++) new_records[i] = records[i];
-            free(records);
-            records = new_records;
-        }
-        records[recordCnt++] = b;
+void optimizeAfterInline(int idx, void* funcs) {
+    interCode* code = ((interCode**)funcs)[idx];
+    beginOptimize(code);
+    if (OptLevel >= 2) runPasses(PASSES(GlobalPasses), code);
+    runToFixedPoint(PASSES(LocalPasses), code);
+    runToFixedPoint(PASSES(LabelPasses), code);
+    if (OptLevel >= 2) {
+        runPasses(PASSES(CfgPasses), code);
+        runToFixedPoint(PASSES(LabelPasses), code);
     }
+    runToFixedPoint(PASSES(LocalPasses), code);
+    endOptimize(code);
+}
 
-    for (int i = 0; i < recordCnt; i++) {
-        freeBlocks(records[i]);
+int optimize(interCode** funcs, int count, root_t* candidates) {
+    if (OptLevel <= 0) return count;
+    if (OptLevel == 1) {
+        // no inlining, each function on its own
+        parallelFor(count, optimizeAfterInline, funcs);
+        return count;
     }
+
+    // functions only depend on each other through inlining,
+    // so everything else is done per function on the thread pool
+    parallelFor(count, optimizeBeforeInline, funcs);
+
+    // inlining reads callees and allocates ids, keep it serial
+    int left = inlineFunctions(funcs, count, candidates);
+    parallelFor(left, optimizeAfterInline, funcs);
+    return left;
 }
 
-void optimize(root_t* funtable) {
-    int time = 0;
-    do {
-        HAS_PROGRESS = false;
-        simpleOptimize(funtable);
-        if (!HAS_PROGRESS && time <= 0) {
-            // only do once global optimize
-            ++time;
-
-            for (map_t* node = map_first(funtable); node;
-                 node = map_next(&(node->node))) {
-                replaceInlineFunction((interCode*)node->val, funtable);
-            }
-            globalOptimize(funtable);
-        }
-    } while (HAS_PROGRESS);
-
-    // Remove Label after all things done
-    // To simplify Block Relation
-
-    for (map_t* node = map_first(funtable); node;
-         node = map_next(&(node->node))) {
-        interCode* code = (interCode*)node->val;
-        do {
-            HAS_PROGRESS = false;
-            mergeCondGoto(code);
-            removeUselessLabel(code);
-        } while (HAS_PROGRESS);
-    }
-    do {
-        HAS_PROGRESS = false;
-        simpleOptimize(funtable);
-    } while (HAS_PROGRESS);
-}
\ No newline at end of file
+interCode** finishCandidates(root_t* candidates, root_t* reached) {
+    // candidates main reaches have to be emitted, the others are dead
+    int left;
+    interCode** funcs = takeCandidates(candidates, reached, &left);
+    parallelFor(left, optimizeAfterInline, funcs);
+    return funcs;
+}
@@ -3,13 +3,22 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "block.h"
 #include "intercode.h"
 #include "map.h"
 
-void optimize(root_t* funtable);
-
-extern root_t InlineTable;
+// optimize funcs[0 .. count) in source order, small functions are moved
+// into candidates to be inlined into callers, see inlineFunctions,
+// return how many functions are left in funcs
+int optimize(interCode** funcs, int count, root_t* candidates);
+// candidates main reaches, optimized and NULL terminated, reached gets
+// the names of all functions main reaches, see takeCandidates
+interCode** finishCandidates(root_t* candidates, root_t* reached);
+// "passes": {...} of --time-report (times) or --stats (counts)
+void passesReport(FILE* f, bool times);
+// -O0: none, -O1: per function passes only, -O2: inlining & flow graph
+extern int OptLevel;
 
 #endif
\ No newline at end of file
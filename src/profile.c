@@ -0,0 +1,83 @@
+#include "profile.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "block.h"
+
+bool ProfileGenerate = false;
+long long ProfileMax = 0;
+
+static long long* Counts = NULL;  // Barrel <int, long long> (block, count)
+static int countCap = 0;
+static int blockSeq = 0;  // blocks numbered so far
+
+bool loadProfile(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        int id;
+        long long count;
+        // # starts a comment
+        if (line[0] == '#' || sscanf(line, "%d %lld", &id, &count) != 2 ||
+            id < 0)
+            continue;
+        if (id >= countCap) {
+            int capacity = countCap > 0 ? countCap : 256;
+            while (capacity <= id) capacity *= 2;
+            Counts =
+                (long long*)realloc(Counts, sizeof(long long) * capacity);
+            memset(Counts + countCap, 0,
+                   sizeof(long long) * (capacity - countCap));
+            countCap = capacity;
+        }
+        Counts[id] = count;
+        if (count > ProfileMax) ProfileMax = count;
+    }
+    fclose(f);
+    return true;
+}
+
+static interCode* counterEntry(block* b) {
+    // the counter goes behind the code returned
+    interCode* first = b->first;
+    if (first->ic_type == FUNCTION) {
+        // the parameters are taken first
+        while (first->next->ic_type == PARAM) first = first->next;
+        return first;
+    }
+    if (first->ic_type == LABEL) return first;
+    return first->prev;
+}
+
+void instrumentBlocks(interCode* head) {
+    enterFunction(head);
+    initBlock();
+    block* entry = getBlocks(head);
+    for (block* b = entry; b; b = b->next) {
+        interCode* counter = mergeCode(
+            newSingleOprCode(ARG, newOperand(CONST, blockSeq++)),
+            newCallCode(allocTemp(), PROFILE_FUNC));
+        insertCodeAfter(counterEntry(b), counter);
+    }
+    freeBlocks(entry);
+    leaveFunction(head);
+}
+
+void annotateBlocks(interCode* head) {
+    initBlock();
+    block* entry = getBlocks(head);
+    for (block* b = entry; b; b = b->next) {
+        int id = blockSeq++;
+        // blocks that never ran have no line
+        long long count = id < countCap ? Counts[id] : 0;
+        for (interCode* iter = b->first;; iter = iter->next) {
+            iter->freq = count;
+            if (iter == b->end) break;
+        }
+    }
+    freeBlocks(entry);
+}
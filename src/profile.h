@@ -0,0 +1,31 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdbool.h>
+
+#include "intercode.h"
+
+// Blocks are numbered across the program in the order functions are
+// translated & getBlocks finds them, before any pass runs, so a
+// profile only fits the source it was generated from.
+//
+// -fprofile-generate: each block starts with
+//   ARG #n
+//   t := CALL __prof
+// irsim_cli.py --profile <file> counts the calls & writes a line
+// "n count" for each counter, which -fprofile-use <file> reads back
+
+#define PROFILE_FUNC "__prof"
+
+extern bool ProfileGenerate;
+// hottest block of the profile read, 0 if there is none
+extern long long ProfileMax;
+
+// read the counts, false if the file cannot be read
+bool loadProfile(const char* path);
+// put a counter at the entry of each block of the function
+void instrumentBlocks(interCode* head);
+// give each code the count of its block, see interCode.freq
+void annotateBlocks(interCode* head);
+
+#endif
@@ -0,0 +1,27 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "remarks.h"
+
+#include <stdarg.h>
+
+FILE* RemarkFile = NULL;
+
+static const char* kindNames[] = {"passed", "missed", "analysis"};
+
+void remark(int kind, const char* pass, interCode* func, int line,
+            const char* fmt, ...) {
+    if (RemarkFile == NULL) return;
+    char reason[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(reason, sizeof(reason), fmt, args);
+    va_end(args);
+    // workers remark at the same time, a line is written at once
+    flockfile(RemarkFile);
+    fprintf(RemarkFile,
+            "{\"kind\": \"%s\", \"pass\": \"%s\", \"function\": \"%s\", "
+            "\"line\": %d, \"reason\": \"%s\"}\n",
+            kindNames[kind], pass, func->func_name,
+            line > 0 ? line : func->line, reason);
+    funlockfile(RemarkFile);
+}
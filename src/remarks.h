@@ -0,0 +1,25 @@
+#ifndef __REMARKS_H__
+#define __REMARKS_H__
+
+#include <stdio.h>
+
+#include "intercode.h"
+
+// --remarks <file>: why the passes did or did not transform the code,
+// one JSON object per line:
+//   {"kind": "missed", "pass": "inline", "function": "main",
+//    "line": 12, "reason": "..."}
+
+enum remark_kinds {
+    RM_PASSED = 0,  // the transformation was done
+    RM_MISSED,      // it was considered & not done
+    RM_ANALYSIS,    // a fact a later decision depends on
+};
+
+extern FILE* RemarkFile;  // NULL if remarks are off
+
+// func is the FUNCTION code, line 0 means the line of the function
+void remark(int kind, const char* pass, interCode* func, int line,
+            const char* fmt, ...);
+
+#endif
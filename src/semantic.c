@@ -2,44 +2,45 @@
 
 const static int INIT_EXP_LEN = 1024;
 static unsigned long long unamed_struct = 0;
+static int errorCount = 0;
+static bool quietMode = false;  // only count errors, don't report them
+static FILE* diagOut = NULL;    // where errors go, stderr if NULL
 // count unamed_structs so each of them can get a unique name
 // similarly, we have var 'dup_param' in parseVarList
 
 // TODO: write semantic analysis here
-type* parseSpecifier(treeNode* spec);
 type* parseStructSpecifier(treeNode* spec);
 type* parseExp(treeNode* exp);
 type* parseVarDec(treeNode* vardec, type* this, char* varname);
-void parseExtDef(treeNode* extdeflist);
-void parseExtDec(treeNode* list, type* this);
 void parseExtFunc(treeNode* extdef);
 void parseExtSpec(treeNode* spec);
 void parseExtStructSpec(treeNode* spec);
 void parseDef(treeNode* list, type* parent);
 void parseDec(treeNode* list, type* this, type* parent);
-void parseFuncDec(treeNode* fundec, type* retval);
 void parseVarList(treeNode* varlist, type* parent);
 void parseCompSt(treeNode* compst, type* retval);
 void parseStmtList(treeNode* list, type* retval);
 void parseStmt(treeNode* list, type* retval);
-bool checkArgs(treeNode* arglist, type* func);
+bool checkArgs(treeNode* arglist, type* func, type* (*argType)(treeNode*));
 bool checkFieldNoArray(field* fields);
-bool isLeftValue(treeNode* exp);
 char* showExp(treeNode* exp);
 static void _showExpR(treeNode* exp, char** buffer, int* len, int* maxLen);
 
 void semError(int errid, int lineno, const char* msg) {
-    fprintf(stderr, "Error type %d at Line %d: ", errid, lineno);
+    errorCount++;
+    if (quietMode) return;
+    FILE* out = diagOut ? diagOut : stderr;
+    fprintf(out, "Error type %d at Line %d: ", errid, lineno);
     if (msg) {
-        fprintf(stderr, errmsgN[errid], msg);
+        fprintf(out, errmsgN[errid], msg);
     } else {
-        fprintf(stderr, errmsgN[errid]);
+        fprintf(out, errmsgN[errid]);
     }
-    fprintf(stderr, ".\n");
+    fprintf(out, ".\n");
 }
 
 void expError(int errid, int lineno, treeNode* exp) {
-    if (exp == NULL) {
+    if (exp == NULL || quietMode) {
         semError(errid, lineno, NULL);
     } else {
         char* msg = showExp(exp);
@@ -49,10 +50,11 @@ void expError(int errid, int lineno, treeNode* exp) {
 }
 
 void parseExtDef(treeNode* extdeflist) {
-    if (extdeflist->childs == NULL) return;
-    treeNode* extdef = extdeflist->childs[0];
-    treeNode* nextlist = extdeflist->childs[1];
+    for (int i = 0; i < extdeflist->childCnt; i++)
+        checkExtDef(extdeflist->childs[i]);
+}
 
+void checkExtDef(treeNode* extdef) {
     treeNode* spec = extdef->childs[0];
     type* vartype;
     switch (extdef->childs[1]->token) {
@@ -68,16 +70,13 @@ void parseExtDef(treeNode* extdeflist) {
             vartype = parseSpecifier(spec);
             // [ExtDef: Specifier ExtDecList SEMI]
             if (vartype != NULL) parseExtDec(extdef->childs[1], vartype);
-            freeType(vartype);
             break;
         default:
             assert(0);
     }
-    parseExtDef(nextlist);
 }
 
 type* parseSpecifier(treeNode* spec) {
-    // Note: free retval after use
     treeNode* child = spec->childs[0];
     // [Specifier: TYPE | StructSpecifier]
     switch (child->token) {
@@ -123,7 +122,7 @@ type* parseStructSpecifier(treeNode* spec) {
             semError(NOT_STRUCT, tag->lineNum, structname);
             return NULL;
         }
-        return copyType(t);
+        return t;
     }
     // [StructSpecifier: STRUCT OptTag LC DefList RC]
     // [OptTag]
@@ -153,9 +152,8 @@ type* parseStructSpecifier(treeNode* spec) {
     // add to symbol table if ret has a name
     if (tag->childs != NULL) {
         // OptTag is not empty
-        tableInsert(structname, copyType(ret));
+        tableInsert(structname, ret);
     }
-    freeType(placeholder);
     return ret;
 }
 
@@ -194,10 +192,8 @@ void parseExtStructSpec(treeNode* spec) {
     // add to symbol table if ret has a name
     if (tag->childs != NULL) {
         // OptTag is not empty
-        tableInsert(structname, copyType(ret));
+        tableInsert(structname, ret);
     }
-    freeType(placeholder);
-    freeType(ret);
     return;
 }
 
@@ -218,7 +214,6 @@ void parseDef(treeNode* list, type* parent) {
     if (t != NULL) {
         parseDec(declist, t, parent);
     }
-    freeType(t);
 
     // [DefList: Def DefList]
     parseDef(nextlist, parent);
@@ -232,10 +227,9 @@ void parseExtDec(treeNode* list, type* this) {
         if (isDupVarName(varname)) {
             semError(RE_VAR, list->childs[0]->lineNum, list->childs[0]->str);
         } else {
-            tableInsert(varname, copyType(vartype));
+            tableInsert(varname, vartype);
         }
     }
-    freeType(vartype);
     if (list->childCnt == 3) {
         parseExtDec(list->childs[2], this);
     }
@@ -249,65 +243,76 @@ void parseDec(treeNode* list, type* this, type* parent) {
     treeNode* vardec = dec->childs[0];
     // parse Dec here
     // [DecList: Dec]
-    char varname[32];
-    type* vartype = parseVarDec(vardec, this, varname);
-    if (dec->childCnt == 1) {
-        // [Dec: VarDec]
-        if (parent != NULL) {
-            // struct : insert into struct field
+    if (parent != NULL) {
+        // struct : insert into struct field
+        char varname[32];
+        type* vartype = parseVarDec(vardec, this, varname);
+        if (dec->childCnt == 1) {
+            // [Dec: VarDec]
             if (!insertField(parent, newField(varname, vartype))) {
                 // duplicate names in structure field
                 semError(RE_FIELD, dec->childs[0]->lineNum, varname);
             }
         } else {
-            // insert into symtab
-            // need to check whether is the same name with structure
-            if (isDupVarName(varname)) {
-                semError(RE_VAR, dec->childs[0]->lineNum, varname);
-            } else {
-                tableInsert(varname, copyType(vartype));
-            }
-        }
-    } else {
-        // dec->childCnt == 3
-        // [Dec: VarDec ASSIGNOP Exp]
-        if (parent != NULL) {
+            // [Dec: VarDec ASSIGNOP Exp]
             // assign in structure
             semError(RE_FIELD, dec->childs[1]->lineNum, varname);
             // still try to insert this field despite error
             insertField(parent, newField(varname, vartype));
-        } else {
-            // insert into symtab
-            if (isDupVarName(varname)) {
-                semError(RE_VAR, dec->childs[0]->lineNum, varname);
-            } else {
-                tableInsert(varname, copyType(vartype));
-            }
-
-            type* exptype = parseExp(dec->childs[2]);
-            if (exptype && !typeEqual(exptype, vartype))
-                semError(AS_TYPE, dec->childs[1]->lineNum, NULL);
-
-            freeType(exptype);
         }
+    } else {
+        // insert into symtab
+        type* vartype = declareVar(vardec, this);
+        // [Dec: VarDec ASSIGNOP Exp]
+        if (dec->childCnt == 3)
+            checkInit(dec, parseExp(dec->childs[2]), vartype);
     }
-    freeType(vartype);
 
     // [DecList: Dec COMMA DecList]
     if (list->childCnt == 3) parseDec(list->childs[2], this, parent);
 }
 
+type* declareVar(treeNode* vardec, type* this) {
+    // insert the variable declared by vardec into current scope
+    // need to check whether is the same name with structure
+    char varname[32];
+    type* vartype = parseVarDec(vardec, this, varname);
+    if (isDupVarName(varname)) {
+        semError(RE_VAR, vardec->lineNum, varname);
+    } else {
+        tableInsert(varname, vartype);
+    }
+    return vartype;
+}
+
+void checkInit(treeNode* dec, type* exptype, type* vartype) {
+    // [Dec: VarDec ASSIGNOP Exp]
+    if (exptype && !typeEqual(exptype, vartype))
+        semError(AS_TYPE, dec->childs[1]->lineNum, NULL);
+}
+
+void checkReturn(treeNode* stmt, type* exptype, type* retval) {
+    // [Stmt: RETURN Exp SEMI]
+    // if exp failed, don't report return type
+    if (exptype && !typeEqual(exptype, retval))
+        semError(RET_TYPE, stmt->childs[1]->lineNum, NULL);
+}
+
+void checkCond(treeNode* exp, type* exptype) {
+    // condition of IF / WHILE
+    if (exptype && exptype->typeId != IntType)
+        expError(NOT_INT, exp->lineNum, exp);
+}
+
 type* parseVarDec(treeNode* vardec, type* this, char* varname) {
     if (vardec->childCnt == 1) {
         // [VarDec: ID]
         strcpy(varname, vardec->childs[0]->str);
-        return copyType(this);
+        return this;
     }
     // [VarDec: VarDec LB INT RB]
-    type* arr = newType(ArrayType);
-    arr->array.itemtype = parseVarDec(vardec->childs[0], this, varname);
-    arr->array.size = atoi(vardec->childs[2]->str);
-    return arr;
+    type* itemtype = parseVarDec(vardec->childs[0], this, varname);
+    return arrayType(itemtype, atoi(vardec->childs[2]->str));
 }
 
 void parseExtFunc(treeNode* extdef) {
@@ -323,8 +328,6 @@ void parseExtFunc(treeNode* extdef) {
     parseDef(compst->childs[1], NULL);
     parseStmtList(compst->childs[2], retval);
 
-    freeType(retval);
-
     delScope();  // del the scope created by FuncDec, kind of weired
 }
 
@@ -333,29 +336,28 @@ void parseFuncDec(treeNode* fundec, type* retval) {
     // Add param to inner symbol table
     // No matter whether there're errs in next Comptst
     // [FunDec: ID LP VarList RP]
-    bool isValid = false;
+    symbol* sym = NULL;  // entry in global scope, if inserted
     char funcname[32];
     strcpy(funcname, fundec->childs[0]->str);
     type* fun = newType(FuncType);
-    fun->func.retval = copyType(retval);
+    fun->func.retval = retval;
     if (isDupVarName(funcname))
         semError(RE_FUNC, fundec->childs[0]->lineNum, funcname);
     else {
-        isValid = true;
-        tableInsert(funcname, fun);
+        // into the global scope, before newScope() opens the params' one
+        sym = tableInsert(funcname, fun);
         // Note: pointer 'fun' will be modified afterwards
-        //       shouldn't make a copy here
+        //       until its params are inserted
     }
-    // call newScope after the function was inserted
-    // then insert params, weired
     newScope();
     if (fundec->childs[2]->token == VarList) {
         parseVarList(fundec->childs[2], fun);
     }
-    if (!isValid) {
-        // func can be freed only when not inserted
-        freeType(fun);
-    }
+    // args are complete now, replace the builder with the interned type.
+    // internType frees the builder if the same signature exists already,
+    // so the global entry has to be updated, not inserted again here
+    fun = internType(fun);
+    if (sym) sym->t = fun;
 }
 
 void parseVarList(treeNode* varlist, type* parent) {
@@ -377,12 +379,10 @@ void parseVarList(treeNode* varlist, type* parent) {
                     sprintf(paramname, "<dup-%x>", dup_param);
                     dup_param++;
                 }
-                tableInsert(paramname, copyType(vartype));
+                tableInsert(paramname, vartype);
                 if (!insertArg(parent, newField(paramname, vartype)))
                     DEBUG("failed to insert param\n");
             }
-            freeType(spec);
-            freeType(vartype);
         }
         if (varlist->childCnt == 3)
             varlist = varlist->childs[2];
@@ -418,15 +418,12 @@ void parseStmt(treeNode* stmt, type* retval) {
             break;
         case RETURN:
             tmp = parseExp(stmt->childs[1]);
-            // if exp failed, don't report return type
-            if (tmp && !typeEqual(tmp, retval))
-                semError(RET_TYPE, stmt->childs[1]->lineNum, NULL);
+            checkReturn(stmt, tmp, retval);
             break;
         case IF:
         case WHILE:
             tmp = parseExp(stmt->childs[2]);
-            if (tmp && tmp->typeId != IntType)
-                expError(NOT_INT, stmt->childs[2]->lineNum, stmt->childs[2]);
+            checkCond(stmt->childs[2], tmp);
             parseStmt(stmt->childs[4], retval);
             if (stmt->childCnt == 7) parseStmt(stmt->childs[6], retval);
             break;
@@ -438,7 +435,6 @@ void parseStmt(treeNode* stmt, type* retval) {
                 DEBUG("  [%d] %d\n", i + 1, stmt->childs[i]->token);
             assert(0);
     }
-    freeType(tmp);
 }
 
 type* parseExp(treeNode* exp) {
@@ -449,46 +445,10 @@ type* parseExp(treeNode* exp) {
         case ID:
             // [Exp: ID | ID LP Args RP | ID LP RP]
             varname = exp->childs[0]->str;
-            opr1 = tableFind(varname);
-
-            if (exp->childCnt == 1) {
-                if (opr1 == NULL) {
-                    // undefined variable
-                    semError(UN_VAR, exp->childs[0]->lineNum, varname);
-                    return NULL;
-                }
-                // struct A a; a = A;
-                // ensure ID is not a name of struct definition
-                if (opr1 && opr1->typeId == StructType &&
-                    isStructDefinition(opr1, varname)) {
-                    semError(INV_STRUCT, exp->childs[0]->lineNum, varname);
-                    return NULL;
-                }
-                // from symbol table, copy
-                return copyType(opr1);
-            } else {
-                if (opr1 == NULL) {
-                    // undefined function
-                    semError(UN_FUNC, exp->childs[0]->lineNum, varname);
-                    return NULL;
-                }
-                // check function call here
-                if (opr1->typeId != FuncType) {
-                    semError(NOT_FUNC, exp->childs[0]->lineNum, varname);
-                    return NULL;
-                }
-                treeNode* arglist = NULL;  // NULL stands for no arguments
-                // [Exp: ID LP Args RP]
-                if (exp->childCnt == 4) arglist = exp->childs[2];
-                if (!checkArgs(arglist, opr1)) {
-                    // incompatible arguments
-                    char* func = typeToString(opr1, varname);
-                    semError(INC_ARG, exp->childs[0]->lineNum, func);
-                    free(func);
-                }
-                // return-value's type
-                return copyType(opr1->func.retval);
-            }
+            if (exp->childCnt == 1)
+                return checkVariable(exp->childs[0], tableFind(varname));
+            else
+                return checkCall(exp, tableFind(varname), parseExp);
         case INT:
             // [Exp: INT]
             return newType(IntType);
@@ -499,31 +459,11 @@ type* parseExp(treeNode* exp) {
             // [Exp: LP Exp RP]
             return parseExp(exp->childs[1]);
         case MINUS:
-            // [Exp: MINUS Exp]
-            opr1 = parseExp(exp->childs[1]);
-            if (opr1 == NULL)
-                return NULL;  // has failed before
-            else if (opr1->typeId == IntType || opr1->typeId == FloatType) {
-                return opr1;  // needn't copy here
-            } else {
-                // free type when it can no more be used
-                freeType(opr1);
-                semError(OP_TYPE, exp->childs[1]->lineNum, NULL);
-                return NULL;
-            }
         case NOT:
-            // [Exp: NOT Exp]
+            // [Exp: MINUS Exp | NOT Exp]
             opr1 = parseExp(exp->childs[1]);
-            if (opr1 == NULL)
-                return NULL;  // has failed before
-            else if (opr1->typeId == IntType) {
-                return opr1;  // needn't copy here
-            } else {
-                // free type when it can no more be used
-                freeType(opr1);
-                semError(OP_TYPE, exp->childs[1]->lineNum, NULL);
-                return NULL;
-            }
+            if (opr1 == NULL) return NULL;  // has failed before
+            return checkOperator(exp, opr1, NULL);
         default:  // i.e. production startswith [Exp]
             assert(exp->childs[0]->token == Exp);
             assert(exp->childCnt >= 3);
@@ -536,20 +476,17 @@ type* parseExp(treeNode* exp) {
     if (exp->childs[2]->token == ID) {
         // Special Case
         // [Exp: Exp DOT ID]
-        if (opr1 == NULL) return NULL;
         if (opr1->typeId != StructType) {
-            freeType(opr1);
             expError(NOT_STRUCT, exp->childs[0]->lineNum, exp->childs[0]);
             return NULL;
         } else {
             char* idname = exp->childs[2]->str;
             type* ret = findField(opr1, idname);
             if (ret == NULL) {
-                freeType(opr1);
                 semError(NON_FIELD, exp->childs[2]->lineNum, idname);
                 return NULL;
             }
-            return copyType(ret);
+            return ret;
         }
     }
     // [Exp: Exp <Operator> Exp]
@@ -557,22 +494,87 @@ type* parseExp(treeNode* exp) {
     // if opr2 fails, don't check the rest of exp
     if (opr2 == NULL) return NULL;
     assert(opr2);
+    return checkOperator(exp, opr1, opr2);
+}
+
+type* checkVariable(treeNode* id, type* t) {
+    // [Exp: ID], t is what the name resolves to
+    if (t == NULL) {
+        // undefined variable
+        semError(UN_VAR, id->lineNum, id->str);
+        return NULL;
+    }
+    // struct A a; a = A;
+    // ensure ID is not a name of struct definition
+    if (t->typeId == StructType && isStructDefinition(t, id->str)) {
+        semError(INV_STRUCT, id->lineNum, id->str);
+        return NULL;
+    }
+    // types are interned, share the one in symbol table
+    return t;
+}
+
+type* checkCall(treeNode* exp, type* func, type* (*argType)(treeNode*)) {
+    // [Exp: ID LP Args RP | ID LP RP], func is what ID resolves to
+    char* funcname = exp->childs[0]->str;
+    if (func == NULL) {
+        // undefined function
+        semError(UN_FUNC, exp->childs[0]->lineNum, funcname);
+        return NULL;
+    }
+    // check function call here
+    if (func->typeId != FuncType) {
+        semError(NOT_FUNC, exp->childs[0]->lineNum, funcname);
+        return NULL;
+    }
+    treeNode* arglist = NULL;  // NULL stands for no arguments
+    // [Exp: ID LP Args RP]
+    if (exp->childCnt == 4) arglist = exp->childs[2];
+    if (!checkArgs(arglist, func, argType)) {
+        // incompatible arguments
+        char* msg = typeToString(func, funcname);
+        semError(INC_ARG, exp->childs[0]->lineNum, msg);
+        free(msg);
+    }
+    // return-value's type
+    return func->func.retval;
+}
+
+type* checkOperator(treeNode* exp, type* opr1, type* opr2) {
+    // opr1 (& opr2) are the checked types of exp's operands
+    assert(opr1);
+    switch (exp->childs[0]->token) {
+        case MINUS:
+            // [Exp: MINUS Exp]
+            if (opr1->typeId == IntType || opr1->typeId == FloatType) {
+                return opr1;
+            } else {
+                semError(OP_TYPE, exp->childs[1]->lineNum, NULL);
+                return NULL;
+            }
+        case NOT:
+            // [Exp: NOT Exp]
+            if (opr1->typeId == IntType) {
+                return opr1;
+            } else {
+                semError(OP_TYPE, exp->childs[1]->lineNum, NULL);
+                return NULL;
+            }
+        default:
+            break;
+    }
+    assert(opr2);
     switch (exp->childs[1]->token) {
         // Assignment
         case ASSIGNOP:
             if (!typeEqual(opr1, opr2)) {
-                freeType(opr1);
-                freeType(opr2);
                 semError(AS_TYPE, exp->childs[2]->lineNum, NULL);
                 return NULL;
             } else {
                 if (!isLeftValue(exp->childs[0])) {
-                    freeType(opr1);
-                    freeType(opr2);
                     semError(AS_RVAL, exp->childs[0]->lineNum, NULL);
                     return NULL;
                 }
-                freeType(opr2);
                 return opr1;
             }
         // Logic operation
@@ -580,12 +582,9 @@ type* parseExp(treeNode* exp) {
         case OR:
             // only int can do logic operation
             if (opr1->typeId != opr2->typeId || opr1->typeId != IntType) {
-                freeType(opr1);
-                freeType(opr2);
                 semError(OP_TYPE, exp->childs[1]->lineNum, NULL);
                 return NULL;
             }
-            freeType(opr2);
             return opr1;
         // Arithmetic operation
         case PLUS:
@@ -595,50 +594,35 @@ type* parseExp(treeNode* exp) {
             // only int & float can do arithmetic operation
             if (opr1->typeId != opr2->typeId ||
                 (opr1->typeId != IntType && opr1->typeId != FloatType)) {
-                freeType(opr1);
-                freeType(opr2);
                 semError(OP_TYPE, exp->childs[1]->lineNum, NULL);
                 return NULL;
             }
-            freeType(opr2);
             return opr1;
         case RELOP:
             // only int & float can do arithmetic operation
             if (opr1->typeId != opr2->typeId ||
                 (opr1->typeId != IntType && opr1->typeId != FloatType)) {
-                freeType(opr1);
-                freeType(opr2);
                 semError(OP_TYPE, exp->childs[1]->lineNum, NULL);
                 return NULL;
             }
-            freeType(opr1);
-            freeType(opr2);
             return newType(IntType);  // Here Must Return Int Type, Failed D-3
         // Array index
         case LB:
             // array index, return array[index]'s type
             if (opr1->typeId != ArrayType) {
-                freeType(opr1);
-                freeType(opr2);
                 expError(NOT_ARR, exp->childs[0]->lineNum, exp->childs[0]);
                 return NULL;
             } else if (opr2->typeId != IntType) {
-                freeType(opr1);
-                freeType(opr2);
                 expError(NOT_INT, exp->childs[2]->lineNum, exp->childs[2]);
                 return NULL;
             }
-            if (!opr1) return NULL;
-            type* ret = copyType(opr1->array.itemtype);
-            freeType(opr1);
-            freeType(opr2);
-            return ret;
+            return opr1->array.itemtype;
         default:
             assert(0);
     }
 }
 
-bool checkArgs(treeNode* arglist, type* func) {
+bool checkArgs(treeNode* arglist, type* func, type* (*argType)(treeNode*)) {
     assert(func != NULL);
     assert(func->typeId == FuncType);
     if (arglist == NULL && func->func.args == NULL) return true;
@@ -647,12 +631,10 @@ bool checkArgs(treeNode* arglist, type* func) {
     field* fp = func->func.args;
     type* arg = NULL;
     while (node && fp) {
-        arg = parseExp(node->childs[0]);
+        arg = argType(node->childs[0]);
         if (!typeEqual(arg, fp->fieldtype)) {
-            freeType(arg);
             return false;
         }
-        freeType(arg);
         if (node->childCnt == 1)
             node = NULL;
         else
@@ -688,10 +670,12 @@ bool isLeftValue(treeNode* exp) {
         // [ID]
         char* varname = exp->childs[0]->str;
         type* t = tableFind(varname);
-        if (t->typeId == IntType || t->typeId == FloatType) {
+        // arrays are assigned item by item
+        if (t->typeId == IntType || t->typeId == FloatType ||
+            t->typeId == ArrayType) {
             return true;
         }
-        if (t->typeId == FuncType || t->typeId == ArrayType || t->typeId = StructPlaceHolder) {
+        if (t->typeId == FuncType || t->typeId == StructPlaceHolder) {
             return false;
         }
         if (t->typeId == StructType) {
@@ -743,4 +727,22 @@ void semantic() {
     treeNode* extdeflist = root->childs[0];
     newScope();  // global scope
     parseExtDef(extdeflist);
-}
\ No newline at end of file
+}
+
+void declareBuiltins() {
+    // read() & write() are provided to translated programs
+    type* read = newType(FuncType);
+    read->func.retval = newType(IntType);
+    tableInsert("read", internType(read));
+
+    type* write = newType(FuncType);
+    write->func.retval = newType(IntType);
+    insertArg(write, newField("n", newType(IntType)));
+    tableInsert("write", internType(write));
+}
+
+void setSemanticQuiet(bool quiet) { quietMode = quiet; }
+
+void setSemanticOutput(FILE* fp) { diagOut = fp; }
+
+int semanticErrors() { return errorCount; }
\ No newline at end of file
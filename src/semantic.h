@@ -6,4 +6,24 @@
 
 void semantic();
 
+// the translator checks each node with these as it translates,
+// so that a program is walked only once
+void declareBuiltins();
+void setSemanticQuiet(bool quiet);
+void setSemanticOutput(FILE* fp);
+int semanticErrors();
+void parseExtDef(treeNode* extdeflist);
+void checkExtDef(treeNode* extdef);
+void parseExtDec(treeNode* list, type* this);
+void parseFuncDec(treeNode* fundec, type* retval);
+type* parseSpecifier(treeNode* spec);
+type* declareVar(treeNode* vardec, type* this);
+type* checkVariable(treeNode* id, type* t);
+type* checkCall(treeNode* exp, type* func, type* (*argType)(treeNode*));
+type* checkOperator(treeNode* exp, type* opr1, type* opr2);
+bool isLeftValue(treeNode* exp);
+void checkInit(treeNode* dec, type* exptype, type* vartype);
+void checkReturn(treeNode* stmt, type* exptype, type* retval);
+void checkCond(treeNode* exp, type* exptype);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#include "stats.h"
+
+#include "optimize.h"
+
+bool Stats = false;
+long long StatCount[STAT_CNT];
+
+static const char* statNames[STAT_CNT] = {
+    "codes_allocated",    "bytes_allocated",    "blocks_built",
+    "fixed_point_rounds", "copies_propagated", "calls_inlined"};
+
+void statsReport(FILE* f) {
+    fprintf(f, "{");
+    for (int i = 0; i < STAT_CNT; i++)
+        fprintf(f, "\"%s\": %lld, ", statNames[i], StatCount[i]);
+    passesReport(f, false);
+    fprintf(f, "}\n");
+}
@@ -0,0 +1,33 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// --stats: counts of what the compiler did, printed as JSON
+
+enum stat_types {
+    ST_CODES = 0,  // intercodes allocated
+    ST_BYTES,      // bytes allocated for intercodes & blocks
+    ST_BLOCKS,     // basic blocks built
+    ST_ROUNDS,     // rounds of runToFixedPoint over its passes
+    ST_COPIES,     // uses replaced by the source of a copy in useReplace
+    ST_INLINED,    // calls inlined
+    STAT_CNT
+};
+
+extern bool Stats;
+extern long long StatCount[STAT_CNT];
+
+// passes count on the thread pool
+#define STAT_ADD(stat, n)                                   \
+    do {                                                    \
+        if (Stats)                                          \
+            __atomic_fetch_add(&StatCount[stat], (long long)(n), \
+                               __ATOMIC_RELAXED);           \
+    } while (0)
+
+// one line of JSON
+void statsReport(FILE* f);
+
+#endif
@@ -1,9 +1,7 @@
 #include "symtab.h"
 
 static symtab* head = NULL;
-
-// created for map to free key-value pair when not used
-void freeValue(void* ptr) { freeType((type*)ptr); }
+static int insertCount = 0;
 
 symtab* newScope() {
     symtab* ret = (symtab*)malloc(sizeof(symtab));
@@ -18,11 +16,39 @@ symtab* delScope() {
     symtab* del = head;
     head = head->parent;
     DEBUG("in delScope()\n");
-    freeMap(&(del->table), freeValue);
+    // types are interned and shared, only free the symbols
+    freeMap(&(del->table), free);
+    free(del);
     return head;
 }
 
-type* tableFind(const char* name) {
+void clearScope() {
+    while (head) delScope();
+}
+
+int tableMark() { return insertCount; }
+
+void tableRollback(int mark) {
+    // leave the global scope as it was when mark was taken
+    assert(head);
+    while (head->parent) delScope();
+    int count = 0, capacity = 8;
+    char** names = (char**)malloc(sizeof(char*) * capacity);
+    for (map_t* node = map_first(&(head->table)); node;
+         node = map_next(&(node->node))) {
+        if (((symbol*)node->val)->order < mark) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            names = (char**)realloc(names, sizeof(char*) * capacity);
+        }
+        names[count++] = node->key;
+    }
+    // erase after the walk, which does not survive removals
+    while (count > 0) erase(&(head->table), names[--count], free);
+    free(names);
+}
+
+symbol* symbolFind(const char* name) {
     symtab* tab = head;
     map_t* res = NULL;
     while (tab) {
@@ -32,12 +58,17 @@ type* tableFind(const char* name) {
             // search it in parent-scope
             tab = tab->parent;
         } else {
-            return (type*)res->val;
+            return (symbol*)res->val;
         }
     }
     return NULL;
 }
 
+type* tableFind(const char* name) {
+    symbol* sym = symbolFind(name);
+    return sym ? sym->t : NULL;
+}
+
 type* tableFindInScope(const char* name) {
     // not recursively
     symtab* tab = head;
@@ -46,13 +77,25 @@ type* tableFindInScope(const char* name) {
         // 'name' not found in this scope
         return NULL;
     } else {
-        return (type*)res->val;
+        return ((symbol*)res->val)->t;
     }
 }
 
-int tableInsert(const char* name, type* t) {
+symbol* tableInsert(const char* name, type* t) {
     assert(head);
-    return put(&(head->table), name, t);
+    map_t* res = get(&(head->table), name);
+    if (res != NULL) {
+        // replace the type, keep the binding
+        ((symbol*)res->val)->t = t;
+        return (symbol*)res->val;
+    }
+    symbol* sym = (symbol*)malloc(sizeof(symbol));
+    sym->t = t;
+    sym->var_id = 0;
+    sym->owner = -1;
+    sym->order = insertCount++;
+    put(&(head->table), name, sym);
+    return sym;
 }
 
 bool isStructDefinition(type* s, const char* structname) {
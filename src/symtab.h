@@ -5,6 +5,15 @@
 #include "map.h"
 #include "type.h"
 
+// a resolved name: its type, and the operand it is bound to while
+// translating a function (var_id is valid only when owner matches)
+typedef struct _symbol {
+    type* t;
+    int var_id;
+    int owner;
+    int order;  // when it was inserted, see tableMark()
+} symbol;
+
 typedef struct _stb {
     root_t table;
     struct _stb* parent;
@@ -12,9 +21,13 @@ typedef struct _stb {
 
 symtab* newScope();
 symtab* delScope();
+void clearScope();
+int tableMark();
+void tableRollback(int mark);
 type* tableFind(const char* name);
 type* tableFindInScope(const char* name);
-int tableInsert(const char* name, type* t);
+symbol* symbolFind(const char* name);
+symbol* tableInsert(const char* name, type* t);
 bool isStructDefinition(type* s, const char* structname);
 bool isDupVarName(const char* varname);
 
@@ -5,6 +5,17 @@
     bool yyperr = false;
     int unhandled = 0;
     int preverr = -1;
+    void (*extDefHandler)(treeNode*) = NULL;  // called on each ExtDef parsed
+
+    #define onExtDef(node) do { \
+        if (extDefHandler) extDefHandler(node); \
+    } while (0)
+    // left recursive, so the stack holds one ExtDef at a time: a handled
+    // one is freed, else the list keeps them all as its children
+    #define onExtDefDone(list, node) do { \
+        if (extDefHandler) freeTree(node); \
+        else if (node) treeInsert(list, node); \
+    } while (0)
 
     #define product(id, location, count, ...) __product(id, #id, location, count, ##__VA_ARGS__)
 
@@ -50,12 +61,12 @@
 Program: ExtDefList { $$ = product(Program, @$, 1, $1); root = $$; }
     ;
 ExtDefList: /* empty */ { $$ = product(ExtDefList, @$, 0); }
-    | ExtDef ExtDefList { $$ = product(ExtDefList, @$, 2, $1, $2); }
+    | ExtDefList ExtDef { $$ = $1; onExtDefDone($$, $2); }
     ;
-ExtDef: Specifier ExtDecList SEMI { $$ = product(ExtDef, @$, 3, $1, $2, $3); }
-    | Specifier SEMI { $$ = product(ExtDef, @$, 2, $1, $2); }
-    | error SEMI { onError(SYN_ERR); }
-    | Specifier FunDec CompSt { $$ = product(ExtDef, @$, 3, $1, $2, $3); }
+ExtDef: Specifier ExtDecList SEMI { $$ = product(ExtDef, @$, 3, $1, $2, $3); onExtDef($$); }
+    | Specifier SEMI { $$ = product(ExtDef, @$, 2, $1, $2); onExtDef($$); }
+    | error SEMI { $$ = NULL; onError(SYN_ERR); }
+    | Specifier FunDec CompSt { $$ = product(ExtDef, @$, 3, $1, $2, $3); onExtDef($$); }
     ;
 ExtDecList: VarDec { $$ = product(ExtDecList, @$, 1, $1); }
     | VarDec COMMA ExtDecList { $$ = product(ExtDecList, @$, 3, $1, $2, $3); }
@@ -0,0 +1,164 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "threadpool.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// each worker owns a deque of task indices
+// owner pops from tail, idle workers steal from head
+typedef struct _taskQueue {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+    int capacity;
+    int* tasks;
+} taskQueue;
+
+static int poolSize = 0;  // workers including the calling thread
+static pthread_t* workers = NULL;
+static taskQueue* queues = NULL;
+
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+static int generation = 0;  // increase when a new job is posted
+static int running = 0;     // workers still busy with current job
+static bool stopping = false;
+
+static void (*jobRoutine)(int, void*) = NULL;
+static void* jobArg = NULL;
+
+static bool popTask(int self, int* task) {
+    taskQueue* q = &queues[self];
+    pthread_mutex_lock(&q->lock);
+    bool found = q->head < q->tail;
+    if (found) *task = q->tasks[--q->tail];
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+static bool stealTask(int self, int* task) {
+    for (int i = 1; i < poolSize; i++) {
+        taskQueue* q = &queues[(self + i) % poolSize];
+        pthread_mutex_lock(&q->lock);
+        bool found = q->head < q->tail;
+        if (found) *task = q->tasks[q->head++];
+        pthread_mutex_unlock(&q->lock);
+        if (found) return true;
+    }
+    return false;
+}
+
+static void runTasks(int self) {
+    int task;
+    while (popTask(self, &task) || stealTask(self, &task)) {
+        jobRoutine(task, jobArg);
+    }
+}
+
+static void* workerMain(void* arg) {
+    int self = (int)(long)arg;
+    int seen = 0;
+    pthread_mutex_lock(&poolLock);
+    while (true) {
+        while (generation == seen && !stopping)
+            pthread_cond_wait(&jobReady, &poolLock);
+        if (stopping) break;
+        seen = generation;
+        pthread_mutex_unlock(&poolLock);
+
+        runTasks(self);
+
+        pthread_mutex_lock(&poolLock);
+        if (--running == 0) pthread_cond_signal(&jobDone);
+    }
+    pthread_mutex_unlock(&poolLock);
+    return NULL;
+}
+
+void initThreadPool(int count) {
+    assert(poolSize == 0);
+    if (count <= 0) count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (count <= 1) return;  // run everything on the calling thread
+
+    poolSize = count;
+    queues = (taskQueue*)malloc(sizeof(taskQueue) * poolSize);
+    for (int i = 0; i < poolSize; i++) {
+        pthread_mutex_init(&queues[i].lock, NULL);
+        queues[i].head = 0;
+        queues[i].tail = 0;
+        queues[i].capacity = 0;
+        queues[i].tasks = NULL;
+    }
+    // worker 0 is the thread calling parallelFor
+    workers = (pthread_t*)malloc(sizeof(pthread_t) * poolSize);
+    for (int i = 1; i < poolSize; i++) {
+        if (pthread_create(&workers[i], NULL, workerMain, (void*)(long)i)) {
+            poolSize = i;  // failed to spawn more, use what we have
+            break;
+        }
+    }
+}
+
+void freeThreadPool() {
+    if (poolSize == 0) return;
+    pthread_mutex_lock(&poolLock);
+    stopping = true;
+    pthread_cond_broadcast(&jobReady);
+    pthread_mutex_unlock(&poolLock);
+    for (int i = 1; i < poolSize; i++) pthread_join(workers[i], NULL);
+    for (int i = 0; i < poolSize; i++) {
+        pthread_mutex_destroy(&queues[i].lock);
+        free(queues[i].tasks);
+    }
+    free(queues);
+    free(workers);
+    queues = NULL;
+    workers = NULL;
+    poolSize = 0;
+    stopping = false;
+}
+
+int threadPoolSize() { return poolSize > 1 ? poolSize : 1; }
+
+void parallelFor(int count, void (*routine)(int idx, void* arg), void* arg) {
+    if (poolSize <= 1 || count <= 1) {
+        for (int i = 0; i < count; i++) routine(i, arg);
+        return;
+    }
+
+    // deal tasks round-robin, all workers are idle at this point
+    int share = count / poolSize + 1;
+    for (int i = 0; i < poolSize; i++) {
+        taskQueue* q = &queues[i];
+        if (q->capacity < share) {
+            free(q->tasks);
+            q->tasks = (int*)malloc(sizeof(int) * share);
+            q->capacity = share;
+        }
+        q->head = 0;
+        q->tail = 0;
+    }
+    for (int i = count - 1; i >= 0; i--) {
+        // push backwards so each owner pops its tasks in ascending order
+        taskQueue* q = &queues[i % poolSize];
+        q->tasks[q->tail++] = i;
+    }
+
+    pthread_mutex_lock(&poolLock);
+    jobRoutine = routine;
+    jobArg = arg;
+    running = poolSize - 1;
+    generation++;
+    pthread_cond_broadcast(&jobReady);
+    pthread_mutex_unlock(&poolLock);
+
+    runTasks(0);
+
+    pthread_mutex_lock(&poolLock);
+    while (running > 0) pthread_cond_wait(&jobDone, &poolLock);
+    pthread_mutex_unlock(&poolLock);
+}
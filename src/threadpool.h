@@ -0,0 +1,19 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <stdbool.h>
+
+// Functions are optimized & emitted in parallel, one function per worker
+// at a time, and never share codes or analyses. Everything a pass or the
+// code generator keeps about the function at hand is declared with this
+// storage class, so each worker has its own copy
+#define THREAD_LOCAL __thread
+
+void initThreadPool(int count);
+void freeThreadPool();
+int threadPoolSize();
+// run routine(0 .. count-1, arg) on all workers, return when all finished
+// Note: routine must not touch shared state other than read-only tables
+void parallelFor(int count, void (*routine)(int idx, void* arg), void* arg);
+
+#endif
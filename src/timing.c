@@ -0,0 +1,74 @@
+#define _DEFAULT_SOURCE
+
+#include "timing.h"
+
+#include <assert.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "optimize.h"
+
+bool TimeReport = false;
+
+static const char* phaseNames[PH_CNT] = {"parse", "translate", "semantic",
+                                         "optimize", "emit"};
+// CPU time is of the whole process, workers included
+static long long phaseWall[PH_CNT];
+static long long phaseCpu[PH_CNT];
+static int stack[PH_CNT * 4];  // phases running, innermost last
+static int depth = 0;
+static long long wallSince = 0;  // when the innermost phase was charged
+static long long cpuSince = 0;
+
+static long long nanos(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+long long wallNanos() { return nanos(CLOCK_MONOTONIC); }
+
+long long threadNanos() { return nanos(CLOCK_THREAD_CPUTIME_ID); }
+
+static void charge() {
+    long long wall = wallNanos();
+    long long cpu = nanos(CLOCK_PROCESS_CPUTIME_ID);
+    if (depth > 0) {
+        phaseWall[stack[depth - 1]] += wall - wallSince;
+        phaseCpu[stack[depth - 1]] += cpu - cpuSince;
+    }
+    wallSince = wall;
+    cpuSince = cpu;
+}
+
+void phaseBegin(int phase) {
+    if (!TimeReport) return;
+    assert(depth < (int)(sizeof(stack) / sizeof(stack[0])));
+    charge();
+    stack[depth++] = phase;
+}
+
+void phaseEnd(int phase) {
+    if (!TimeReport) return;
+    charge();
+    while (depth > 0 && stack[--depth] != phase) continue;
+}
+
+void phaseReport(FILE* f) {
+    long long wall = 0, cpu = 0;
+    fprintf(f, "{\"phases\": {");
+    for (int i = 0; i < PH_CNT; i++) {
+        fprintf(f, "%s\"%s\": {\"wall\": %.6f, \"cpu\": %.6f}",
+                i > 0 ? ", " : "", phaseNames[i], phaseWall[i] * 1e-9,
+                phaseCpu[i] * 1e-9);
+        wall += phaseWall[i];
+        cpu += phaseCpu[i];
+    }
+    fprintf(f, "}, \"total\": {\"wall\": %.6f, \"cpu\": %.6f}, ", wall * 1e-9,
+            cpu * 1e-9);
+    passesReport(f, true);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // kilobytes on Linux
+    fprintf(f, ", \"peak_rss_kb\": %ld}\n", usage.ru_maxrss);
+}
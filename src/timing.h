@@ -0,0 +1,32 @@
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// --time-report: wall & CPU time of each compiler phase, charged to the
+// innermost phase running, so a phase does not include those it calls
+
+enum phase_types {
+    PH_PARSE = 0,  // yyparse, the lexer & building the tree
+    PH_TRANSLATE,  // translateExtDef, semantic checks included
+    PH_SEMANTIC,   // checkExtDef once translation stopped at an error
+    PH_OPTIMIZE,   // optimize & finishCandidates, on the thread pool
+    PH_EMIT,       // assembleFunctions, interCodeOutput or lowering
+    PH_CNT
+};
+
+extern bool TimeReport;
+
+// nanoseconds of the monotonic clock & of the calling thread's CPU
+long long wallNanos();
+long long threadNanos();
+
+// phases are only timed on the main thread
+void phaseBegin(int phase);
+// end phase & whatever it left running, e.g. after a longjmp
+void phaseEnd(int phase);
+// one line of JSON: phases, passes & the peak resident set size
+void phaseReport(FILE* f);
+
+#endif
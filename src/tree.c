@@ -29,6 +29,8 @@ treeNode* newNode(int token, const char* tokenId, int tokenType, int lineNum) {
     strcpy(node->tokenId, tokenId);
     node->tokenType = tokenType;
     node->lineNum = lineNum;
+    node->exptype = NULL;
+    node->sym = NULL;
     return node;
 }
 
@@ -55,6 +57,21 @@ treeNode* treeInsert(treeNode* parent, treeNode* child) {
     return parent;
 }
 
+void freeTree(treeNode* node) {
+    if (!node) return;
+    pruneTree(node);
+    free(node);
+}
+
+void pruneTree(treeNode* node) {
+    // free all descendants, node itself becomes a leaf
+    for (int i = 0; i < node->childCnt; i++) freeTree(node->childs[i]);
+    free(node->childs);
+    node->childs = NULL;
+    node->childCnt = 0;
+    node->capacity = 0;
+}
+
 void printTree(treeNode* token, int indent) {
     if (!token) return;
     // assert(token);
@@ -15,10 +15,15 @@ typedef struct node {
     int capacity;
     // ----------
     int lineNum;  // token position
+    // filled in by the translator
+    struct _type* exptype;  // type of Exp, set once it has been checked
+    struct _symbol* sym;    // declaration an ID resolves to
 } treeNode;
 
 treeNode* newNode(int token, const char* tokenId, int tokenType, int lineNum);
 treeNode* treeInsert(treeNode* parent, treeNode* child);
 void printTree(treeNode* current, int indent);
+void freeTree(treeNode* node);
+void pruneTree(treeNode* node);
 
 #endif
\ No newline at end of file
@@ -3,17 +3,35 @@
 #include <assert.h>
 
 #include "header.h"
+#include "map.h"
 
 static const int INIT_TYPE_LEN = 256;
 
+static type IntSingleton = {IntType, &IntSingleton};
+static type FloatSingleton = {FloatType, &FloatSingleton};
+static type PlaceHolderSingleton = {StructPlaceHolder, &PlaceHolderSingleton};
+
+static root_t TypeTable = RB_ROOT;
+// Map <char*, type*> (structure key, interned type)
+
 type* newType(int typeId) {
-    type* ret = (type*)malloc(sizeof(type));
-    ret->typeId = typeId;
+    // basic types are shared singletons,
+    // array / function types are builders until internType() is called,
+    // every struct definition is its own canonical type
     switch (typeId) {
         case IntType:
+            return &IntSingleton;
         case FloatType:
+            return &FloatSingleton;
         case StructPlaceHolder:
+            return &PlaceHolderSingleton;
+        default:
             break;
+    }
+    type* ret = (type*)malloc(sizeof(type));
+    ret->typeId = typeId;
+    ret->canon = NULL;
+    switch (typeId) {
         case ArrayType:
             ret->array.itemtype = NULL;
             ret->array.size = -1;
@@ -21,6 +39,7 @@ type* newType(int typeId) {
         case StructType:
             ret->structure.name = (char*)malloc(sizeof(char) * 32);
             ret->structure.fields = NULL;
+            ret->canon = ret;
             break;
         case FuncType:
             ret->func.args = NULL;
@@ -32,13 +51,101 @@ type* newType(int typeId) {
     return ret;
 }
 
+static char* typeKey(type* t, bool erase) {
+    // key of t's structure, children are compared by identity
+    // erase: use the canonical children and ignore array size
+    int len = 64;
+    if (t->typeId == FuncType)
+        for (field* f = t->func.args; f; f = f->next) len += 20;
+    char* key = (char*)malloc(sizeof(char) * len);
+    if (t->typeId == ArrayType) {
+        type* item = t->array.itemtype;
+        if (erase && item) item = item->canon;
+        sprintf(key, "A%p[%d]", (void*)item, erase ? -1 : t->array.size);
+    } else {
+        type* retval = t->func.retval;
+        if (erase && retval) retval = retval->canon;
+        int pos = sprintf(key, "F%p(", (void*)retval);
+        for (field* f = t->func.args; f; f = f->next) {
+            type* arg = f->fieldtype;
+            if (erase && arg) arg = arg->canon;
+            pos += sprintf(key + pos, "%p,", (void*)arg);
+        }
+        sprintf(key + pos, ")");
+    }
+    return key;
+}
+
+static type* eraseType(type* t) {
+    // build t with canonical children and erased size, then intern it
+    type* ret = newType(t->typeId);
+    if (t->typeId == ArrayType) {
+        type* item = t->array.itemtype;
+        ret->array.itemtype = item ? item->canon : NULL;
+    } else {
+        ret->func.retval = t->func.retval ? t->func.retval->canon : NULL;
+        field* tail = NULL;
+        for (field* f = t->func.args; f; f = f->next) {
+            field* arg =
+                newField(f->name, f->fieldtype ? f->fieldtype->canon : NULL);
+            if (tail == NULL)
+                ret->func.args = arg;
+            else
+                tail->next = arg;
+            tail = arg;
+        }
+    }
+    return internType(ret);
+}
+
+type* internType(type* t) {
+    // return the shared object structurally identical to builder t
+    // Note: t is released if such an object already exists
+    if (t == NULL || t->canon != NULL) return t;
+    assert(t->typeId == ArrayType || t->typeId == FuncType);
+
+    char* key = typeKey(t, false);
+    map_t* find = get(&TypeTable, key);
+    if (find != NULL) {
+        free(key);
+        if (t->typeId == FuncType) {
+            field* f = t->func.args;
+            while (f) {
+                field* next = f->next;
+                free(f->name);
+                free(f);
+                f = next;
+            }
+        }
+        free(t);
+        return (type*)find->val;
+    }
+    put(&TypeTable, key, t);
+
+    char* erased = typeKey(t, true);
+    if (strcmp(key, erased) == 0)
+        t->canon = t;
+    else
+        t->canon = eraseType(t);
+    free(erased);
+    free(key);
+    return t;
+}
+
+type* arrayType(type* itemtype, int size) {
+    type* ret = newType(ArrayType);
+    ret->array.itemtype = itemtype;
+    ret->array.size = size;
+    return internType(ret);
+}
+
 field* newField(const char* name, type* type) {
     field* ret = (field*)malloc(sizeof(field));
 
     ret->name = (char*)malloc(sizeof(char) * 32);
     strcpy(ret->name, name);
 
-    ret->fieldtype = copyType(type);
+    ret->fieldtype = type;
 
     ret->next = NULL;
     return ret;
@@ -78,83 +185,6 @@ bool insertArg(type* t, field* a) {
     return true;
 }
 
-void freeType(type* t) {
-    if (t) {
-        switch (t->typeId) {
-            case IntType:
-            case FloatType:
-            case StructPlaceHolder:
-                break;
-            case ArrayType:
-                freeType(t->array.itemtype);
-                break;
-            case StructType:
-                free(t->structure.name);
-                freeField(t->structure.fields);
-                break;
-            case FuncType:
-                freeType(t->func.retval);
-                freeField(t->func.args);
-                break;
-            default:
-                assert(0);
-        }
-        free(t);
-    }
-}
-
-void freeField(field* f) {
-    if (f) {
-        free(f->name);
-        freeType(f->fieldtype);
-        freeField(f->next);
-        free(f);
-    }
-}
-
-type* copyType(type* t) {
-    if (!t) return NULL;
-    type* ret = newType(t->typeId);
-    switch (t->typeId) {
-        case IntType:
-        case FloatType:
-        case StructPlaceHolder:
-            return ret;
-        case ArrayType:
-            ret->array.itemtype = copyType(t->array.itemtype);
-            ret->array.size = t->array.size;
-            break;
-        case StructType:
-            strcpy(ret->structure.name, t->structure.name);
-            ret->structure.fields = copyField(t->structure.fields);
-            break;
-        case FuncType:
-            ret->func.retval = copyType(t->func.retval);
-            ret->func.args = copyField(t->func.args);
-            break;
-        default:
-            assert(0);
-    }
-    return ret;
-}
-
-field* copyField(field* f) {
-    field *ret = NULL, *tail = NULL, *tmp;
-    while (f) {
-        tmp = newField(f->name, NULL);
-        tmp->fieldtype = copyType(f->fieldtype);
-        if (!ret) {
-            ret = tmp;
-            tail = tmp;
-        } else {
-            tail->next = tmp;
-            tail = tmp;
-        }
-        f = f->next;
-    }
-    return ret;
-}
-
 type* findField(type* t, const char* fieldname) {
     if (t == NULL || t->typeId != StructType) return NULL;
     field* f = t->structure.fields;
@@ -283,23 +313,9 @@ char* typeToString(type* t, const char* varname) {
 
 bool typeEqual(type* t1, type* t2) {
     if (!t1 || !t2) return false;
-    if (t1->typeId != t2->typeId) return false;
-    switch (t1->typeId) {
-        case StructPlaceHolder:
-        case IntType:
-        case FloatType:
-            return true;
-        case ArrayType:
-            return typeEqual(t1->array.itemtype, t2->array.itemtype);
-        case StructType:
-            // for other group, need to judge field equal
-            return strcmp(t1->structure.name, t2->structure.name) == 0;
-        case FuncType:
-            return typeEqual(t1->func.retval, t2->func.retval) &&
-                   fieldEqual(t1->func.args, t2->func.args);
-        default:
-            assert(0);
-    }
+    // interned types, equal types share the same representative
+    assert(t1->canon && t2->canon);
+    return t1->canon == t2->canon;
 }
 
 bool fieldEqual(field* f1, field* f2) {
@@ -310,4 +326,4 @@ bool fieldEqual(field* f1, field* f2) {
     }
     if (!f1 && !f2) return true;
     return false;
-}
\ No newline at end of file
+}
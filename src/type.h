@@ -22,8 +22,12 @@ struct _field {
     struct _field* next;      // next field
 };
 
+// types are interned: structurally identical types share one object
+// which must not be modified or freed once it has been interned
 struct _type {
-    int typeId;  // kind of type
+    int typeId;           // kind of type
+    struct _type* canon;  // representative of types equal to this one
+                          // (array sizes erased), NULL until interned
     union {
         struct {
             struct _type* itemtype;  // type of array item
@@ -45,15 +49,13 @@ typedef struct _field field;
 typedef struct _type type;
 
 type* newType(int typeId);
+type* arrayType(type* itemtype, int size);
+type* internType(type* t);
 field* newField(const char* name, type* type);
 bool insertField(type* t, field* f);
 bool insertArg(type* t, field* a);
-void freeType(type* t);
-void freeField(field* f);
 void printType(type* t);    // only for test
 void printField(field* f);  // only for test
-type* copyType(type* t);
-field* copyField(field* f);
 bool typeEqual(type* t1, type* t2);
 bool fieldEqual(field* f1, field* f2);
 type* findField(type* t, const char* fieldname);
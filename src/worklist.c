@@ -0,0 +1,51 @@
+#include "worklist.h"
+
+// codes are chained through workPrev/workNext behind this sentinel
+static THREAD_LOCAL interCode queue;
+static THREAD_LOCAL bool tracked = false;
+
+void beginWorklist(interCode* head, bool all) {
+    queue.workPrev = &queue;
+    queue.workNext = &queue;
+    // links left from an earlier function are stale
+    interCode* iter = head;
+    do {
+        iter->workPrev = NULL;
+        iter->workNext = NULL;
+        iter = iter->next;
+    } while (iter != head);
+
+    tracked = true;
+    if (!all) return;
+    do {
+        queueCode(iter);
+        iter = iter->next;
+    } while (iter != head);
+}
+
+void endWorklist() { tracked = false; }
+
+bool isWorklistTracked() { return tracked; }
+
+void queueCode(interCode* code) {
+    if (!tracked || code->workNext != NULL) return;
+    code->workPrev = queue.workPrev;
+    code->workNext = &queue;
+    queue.workPrev->workNext = code;
+    queue.workPrev = code;
+}
+
+void dequeueCode(interCode* code) {
+    if (!tracked || code->workNext == NULL) return;
+    code->workPrev->workNext = code->workNext;
+    code->workNext->workPrev = code->workPrev;
+    code->workPrev = NULL;
+    code->workNext = NULL;
+}
+
+interCode* popCode() {
+    if (!tracked || queue.workNext == &queue) return NULL;
+    interCode* code = queue.workNext;
+    dequeueCode(code);
+    return code;
+}
@@ -0,0 +1,21 @@
+#ifndef __WORKLIST_H__
+#define __WORKLIST_H__
+
+#include <stdbool.h>
+
+#include "intercode.h"
+
+// codes of the function being optimized that peephole rules should
+// look at again: a code is queued when it or the code before it
+// changes. Once begun, insertCodeAfter, removeCode(Itr) & touchCode
+// keep it up to date until endWorklist()
+void beginWorklist(interCode* head, bool all);
+void endWorklist();
+bool isWorklistTracked();
+
+void queueCode(interCode* code);
+void dequeueCode(interCode* code);
+// take the code queued first, NULL if none
+interCode* popCode();
+
+#endif